@@ -4,6 +4,7 @@ option(PDC_UTF8 "Force to UTF8" OFF)
 option(PDC_WIDE "Wide - pulls in sdl-ttf" OFF)
 option(PDCDEBUG "Debug tracing" OFF)
 option(PDC_CHTYPE_32 "CHTYPE_32" OFF)
+option(PDC_THREADSAFE "Thread-safe use_screen()/use_window() (POSIX threads)" OFF)
 option(PDC_OS2_BUILD "Build OS/2 Project" OFF)
 option(PDC_DOS_BUILD "Build DOS Project" OFF)
 option(PDC_DOSVGA_BUILD "Build DOSVGA Project" OFF)
@@ -16,6 +17,7 @@ message(STATUS "PDC_UTF8 ............... ${PDC_UTF8}")
 message(STATUS "PDC_WIDE ............... ${PDC_WIDE}")
 message(STATUS "PDCDEBUG ............... ${PDCDEBUG}")
 message(STATUS "PDC_CHTYPE_32 .......... ${PDC_CHTYPE_32}")
+message(STATUS "PDC_THREADSAFE ......... ${PDC_THREADSAFE}")
 message(STATUS "PDC_OS2_BUILD .......... ${PDC_OS2_BUILD}")
 message(STATUS "PDC_DOS_BUILD .......... ${PDC_DOS_BUILD}")
 message(STATUS "PDC_DOSVGA_BUILD ....... ${PDC_DOSVGA_BUILD}")
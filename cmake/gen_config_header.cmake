@@ -24,6 +24,9 @@ ENDIF (PDC_UTF8)
 IF (PDC_CHTYPE_32)
     ADD_DEFINITIONS(-DCHTYPE_32)
 ENDIF (PDC_CHTYPE_32)
+IF (PDC_THREADSAFE)
+    ADD_DEFINITIONS(-DPDC_THREADSAFE)
+ENDIF (PDC_THREADSAFE)
 IF(PDCDEBUG)
     ADD_DEFINITIONS(-DPDCDEBUG)
 ENDIF(PDCDEBUG)
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+
+"""Generate wcwidth.h, the column width table used by addch.c.
+
+Usage: mkwidth.py [UCD directory] > wcwidth.h
+
+With no arguments, the Unicode data built into Python's unicodedata
+module is used. To track a newer Unicode version than that, pass a
+directory holding UnicodeData.txt and EastAsianWidth.txt from the
+Unicode Character Database (https://www.unicode.org/Public/UCD/latest/).
+
+The widths follow Markus Kuhn's wcwidth():
+
+  - Non-spacing and enclosing combining marks (Mn, Me), format
+    characters (Cf) other than SOFT HYPHEN, ZERO WIDTH SPACE, and the
+    Hangul Jamo medial vowels and final consonants have width 0.
+
+  - Characters with East Asian Width W or F, and the rest of the CJK
+    planes 2 and 3, have width 2. Unassigned code points take the
+    defaults from EastAsianWidth.txt: W in the CJK ideograph blocks,
+    N elsewhere.
+
+  - Everything else has width 1. (addch.c handles NUL and the C0/C1
+    control characters itself.)
+
+The table has two stages: wcwidth_index[] maps each block of 256 code
+points to one of the distinct blocks in wcwidth_blocks[], which pack
+four 2-bit widths per byte.
+"""
+
+import os
+import sys
+
+BLOCK = 256
+MAX_CODE = 0x110000
+
+
+def ranges(path):
+    """Yield (first, last, fields) for each line of a UCD data file."""
+
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            fields = [x.strip() for x in line.split(';')]
+            if '..' in fields[0]:
+                first, last = fields[0].split('..')
+            else:
+                first = last = fields[0]
+            yield int(first, 16), int(last, 16), fields
+
+
+def load_ucd(directory):
+    """Return (version, category, east_asian_width) from UCD files."""
+
+    category = ['Cn'] * MAX_CODE
+    eaw = ['N'] * MAX_CODE
+
+    # ranges like CJK ideographs are given as <..., First> and
+    # <..., Last> lines
+
+    start = None
+    for code, _, fields in ranges(os.path.join(directory,
+                                               'UnicodeData.txt')):
+        if fields[1].endswith(', First>'):
+            start = code
+            continue
+        first = code if start is None else start
+        start = None
+        for c in range(first, code + 1):
+            category[c] = fields[2]
+
+    for first, last, fields in ranges(os.path.join(directory,
+                                                   'EastAsianWidth.txt')):
+        for c in range(first, last + 1):
+            eaw[c] = fields[1]
+
+    version = 'the UCD files in ' + os.path.basename(
+        os.path.abspath(directory))
+    return version, category.__getitem__, eaw.__getitem__
+
+
+# unassigned code points that EastAsianWidth.txt defaults to W
+
+RESERVED_WIDE = ((0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF),
+                 (0x20000, 0x2FFFD), (0x30000, 0x3FFFD))
+
+
+def load_python():
+    """Return (version, category, east_asian_width) from unicodedata."""
+
+    import unicodedata
+
+    # unicodedata gives unassigned code points whatever width it likes
+    # (some versions say F), so they get the UCD's defaults instead
+
+    def eaw(c):
+        if unicodedata.category(chr(c)) != 'Cn':
+            return unicodedata.east_asian_width(chr(c))
+        for first, last in RESERVED_WIDE:
+            if first <= c <= last:
+                return 'W'
+        return 'N'
+
+    return ('Unicode ' + unicodedata.unidata_version,
+            lambda c: unicodedata.category(chr(c)), eaw)
+
+
+def width(c, category, eaw):
+    if c == 0x00AD:
+        return 1
+    if (category(c) in ('Mn', 'Me', 'Cf') or c == 0x200B or
+            0x1160 <= c <= 0x11FF or 0xD7B0 <= c <= 0xD7FF):
+        return 0
+    if (eaw(c) in ('W', 'F') or 0x20000 <= c <= 0x2FFFD or
+            0x30000 <= c <= 0x3FFFD):
+        return 2
+    return 1
+
+
+def hex_rows(values, indent, per_row):
+    """Format values as rows of C hex constants."""
+
+    rows = []
+    for i in range(0, len(values), per_row):
+        rows.append(indent + ', '.join('0x%02x' % v
+                                       for v in values[i:i + per_row]))
+    return ',\n'.join(rows)
+
+
+def main():
+    if len(sys.argv) > 1:
+        version, category, eaw = load_ucd(sys.argv[1])
+    else:
+        version, category, eaw = load_python()
+
+    blocks = {}
+    index = []
+
+    for start in range(0, MAX_CODE, BLOCK):
+        packed = [0] * (BLOCK // 4)
+        for c in range(start, start + BLOCK):
+            packed[(c - start) >> 2] |= (width(c, category, eaw)
+                                         << ((c & 3) * 2))
+        index.append(blocks.setdefault(tuple(packed), len(blocks)))
+
+    if len(blocks) > 256:
+        sys.exit('too many distinct blocks for an 8-bit index')
+
+    out = sys.stdout
+    out.write('/* Column widths of Unicode characters, for mk_wcwidth() in\n'
+              '   addch.c. Generated by common/mkwidth.py from %s'
+              '\n   -- do not edit. */\n\n' % version)
+
+    out.write('static const unsigned char wcwidth_index[%d] =\n{\n'
+              % len(index))
+    out.write(hex_rows(index, '    ', 12))
+    out.write('\n};\n\n')
+
+    out.write('static const unsigned char wcwidth_blocks[%d][%d] =\n{\n'
+              % (len(blocks), BLOCK // 4))
+    out.write(',\n'.join('    {\n%s\n    }' % hex_rows(list(b), '        ', 12)
+                         for b in blocks))
+    out.write('\n};\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -318,6 +318,21 @@ typedef struct
 # define BUTTON_ALT     PDC_BUTTON_ALT
 #endif
 
+/* input events, as returned by PDC_get_events() */
+
+typedef struct
+{
+    int type;                 /* PDC_EVENT_KEY, _MOUSE or _RESIZE */
+    int key;                  /* the key, as wgetch() would return it */
+    bool key_code;            /* TRUE if 'key' is a function key */
+    unsigned long modifiers;  /* as from PDC_get_key_modifiers() */
+    MOUSE_STATUS mouse;       /* for PDC_EVENT_MOUSE, as from getmouse() */
+} PDC_EVENT;
+
+#define PDC_EVENT_KEY       0
+#define PDC_EVENT_MOUSE     1
+#define PDC_EVENT_RESIZE    2
+
 /*----------------------------------------------------------------------
  *
  *  Window and Screen Structures
@@ -350,6 +365,9 @@ typedef struct _win       /* definition of a window */
     int   _delayms;       /* milliseconds of delay for getch() */
     int   _parx, _pary;   /* coords relative to parent (0,0) */
     struct _win *_parent; /* subwin's pointer to parent win */
+#ifdef PDC_THREADSAFE
+    void *_lock;          /* held by use_window() */
+#endif
 } WINDOW;
 
 /* Color pair structure */
@@ -420,8 +438,14 @@ typedef struct
     int   c_ungind;       /* ungetch() push index */
     int   c_ungmax;       /* allocated size of ungetch() buffer */
     PDC_PAIR *atrtab;     /* table of color pairs */
+    bool  check_typeahead; /* if doupdate() yields to pending input */
 } SCREEN;
 
+/* callbacks for use_screen() and use_window() */
+
+typedef int (*NCURSES_SCREEN_CB)(SCREEN *, void *);
+typedef int (*NCURSES_WINDOW_CB)(WINDOW *, void *);
+
 /*----------------------------------------------------------------------
  *
  *  External Variables
@@ -1706,6 +1730,8 @@ PDCEX  bool    is_leaveok(const WINDOW *);
 PDCEX  bool    is_pad(const WINDOW *);
 PDCEX  int     set_tabsize(int);
 PDCEX  int     use_default_colors(void);
+PDCEX  int     use_screen(SCREEN *, NCURSES_SCREEN_CB, void *);
+PDCEX  int     use_window(WINDOW *, NCURSES_WINDOW_CB, void *);
 PDCEX  int     wresize(WINDOW *, int, int);
 
 PDCEX  bool    has_mouse(void);
@@ -1754,7 +1780,12 @@ PDCEX  int     PDC_freeclipboard(char *);
 PDCEX  int     PDC_getclipboard(char **, long *);
 PDCEX  int     PDC_setclipboard(const char *, long);
 
+PDCEX  int     PDC_coalesce_events(bool);
+PDCEX  unsigned long PDC_dropped_events(void);
+PDCEX  int     PDC_get_events(PDC_EVENT *, int, int);
+PDCEX  int     PDC_get_input_fd(void);
 PDCEX  unsigned long PDC_get_key_modifiers(void);
+PDCEX  int     PDC_process_input(void);
 PDCEX  int     PDC_return_key_modifiers(bool);
 PDCEX  void    PDC_set_resize_limits( const int new_min_lines,
                                const int new_max_lines,
@@ -1818,7 +1849,6 @@ PDCEX  int     wunderscore(WINDOW *);
 /* Deprecated */
 
 #define PDC_save_key_modifiers(x)  (OK)
-#define PDC_get_input_fd()         0
 
 /* return codes from PDC_getclipboard() and PDC_setclipboard() calls */
 
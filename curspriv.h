@@ -60,6 +60,7 @@ int     PDC_get_rows(void);
 void    PDC_gotoyx(int, int);
 bool    PDC_has_mouse(void);
 int     PDC_init_color(int, int, int, int);
+long    PDC_millisecs(void);
 int     PDC_modifiers_set(void);
 int     PDC_mouse_set(void);
 void    PDC_napms(int);
@@ -76,18 +77,39 @@ void    PDC_scr_free(void);
 int     PDC_scr_open(void);
 void    PDC_set_keyboard_binary(bool);
 void    PDC_transform_line(int, int, int, const chtype *);
+bool    PDC_wait_for_input(int);
 const char *PDC_sysname(void);
 
 /* Internal cross-module functions */
 
 int     PDC_init_atrtab(void);
+bool    PDC_input_pending(void);
 WINDOW *PDC_makelines(WINDOW *);
 WINDOW *PDC_makenew(int, int, int, int);
+int     PDC_mouse_event(void);
 int     PDC_mouse_in_slk(int, int);
+int     PDC_mouse_timed_event(void);
+int     PDC_mouse_timeout(void);
+int     PDC_paste_keys(int *, long);
 void    PDC_slk_free(void);
 void    PDC_slk_initialize(void);
 void    PDC_sync(WINDOW *);
 
+/* With PDC_THREADSAFE, the screen and each window have a lock; see
+   use_screen() and use_window(). The screen's is always taken first. */
+
+#ifdef PDC_THREADSAFE
+void    PDC_lock_screen(void);
+void    PDC_lock_window(WINDOW *);
+void    PDC_unlock_screen(void);
+void    PDC_unlock_window(WINDOW *);
+#else
+# define PDC_lock_screen()
+# define PDC_lock_window(win)
+# define PDC_unlock_screen()
+# define PDC_unlock_window(win)
+#endif
+
 #ifdef PDC_WIDE
 int     PDC_mbtowc(wchar_t *, const char *, size_t);
 size_t  PDC_mbstowcs(wchar_t *, const char *, size_t);
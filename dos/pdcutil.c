@@ -67,6 +67,23 @@ void PDC_napms( int ms)
     PDC_napmsl( (long)ms);
 }
 
+/* Milliseconds,  from the BIOS tick count.  Converting ticks to ms in
+two parts,  as in PDC_napmsl(),  avoids overflow.  The count goes back
+to zero at midnight;  we add a day's worth of milliseconds when that
+happens,  so that differences between readings stay correct. */
+
+long PDC_millisecs( void)
+{
+    static long prev_ticks = 0L, day_offset = 0L;
+    const long ticks = getdosmemdword(0x46c);
+
+    if( ticks < prev_ticks)     /*  midnight rollover */
+        day_offset += MS_PER_DAY;
+    prev_ticks = ticks;
+    return( day_offset + (ticks / 859L) * 47181L
+                       + (ticks % 859L) * 47181L / 859L);
+}
+
 const char *PDC_sysname(void)
 {
     return "DOS";
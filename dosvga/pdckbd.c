@@ -235,32 +235,13 @@ static int _process_mouse_events(void)
     {
         for (i = 0; i < 3; i++)
         {
+            /* A press and release since the last check is already a
+               click; otherwise, the core makes clicks from the press
+               and the release */
+
             if (button[i].pressed)
-            {
-                /* Check for a click -- a PRESS followed
-                   immediately by a release */
-
-                if (!button[i].released)
-                {
-                    if (SP->mouse_wait)
-                    {
-                        PDCREGS regs;
-
-                        napms(SP->mouse_wait);
-
-                        regs.W.ax = 6;
-                        regs.W.bx = button_map[i];
-                        PDCINT(0x33, regs);
-
-                        SP->mouse_status.button[i] = regs.W.bx ?
-                            BUTTON_CLICKED : BUTTON_PRESSED;
-                    }
-                    else
-                        SP->mouse_status.button[i] = BUTTON_PRESSED;
-                }
-                else
-                    SP->mouse_status.button[i] = BUTTON_CLICKED;
-            }
+                SP->mouse_status.button[i] = button[i].released ?
+                    BUTTON_CLICKED : BUTTON_PRESSED;
 
             if (button[i].pressed || button[i].released)
             {
@@ -278,6 +259,29 @@ static int _process_mouse_events(void)
     return KEY_MOUSE;
 }
 
+/* Wait for a key or mouse event, or for ms milliseconds (ms < 0:
+   forever). There's nothing to block on, so this polls, giving up the
+   time slice between checks as PDC_napms() does. */
+
+bool PDC_wait_for_input(int ms)
+{
+    const long start = PDC_millisecs();
+
+    while (!PDC_check_key())
+    {
+        PDCREGS regs;
+
+        if (ms >= 0 && PDC_millisecs() - start >= ms)
+            return FALSE;
+
+        regs.W.ax = 0x1680;
+        PDCINT(0x2f, regs);
+        PDCINT(0x28, regs);
+    }
+
+    return TRUE;
+}
+
 /* return the next available key or mouse event */
 
 int PDC_get_key(void)
@@ -421,6 +425,13 @@ void PDC_flushinp(void)
     setdosmemword(0x41a, getdosmemword(0x41c));
 }
 
+/* there's no file descriptor to wait on in DOS */
+
+int PDC_get_input_fd(void)
+{
+    return -1;
+}
+
 bool PDC_has_mouse(void)
 {
     PDCREGS regs;
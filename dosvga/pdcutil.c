@@ -39,6 +39,26 @@ void PDC_napms(int ms)
     }
 }
 
+/* Milliseconds from the BIOS tick count (about 18.2 ticks per second),
+   converted in two parts to avoid overflow. The count goes back to zero
+   at midnight; a day's worth of milliseconds is added when that happens,
+   so differences between readings stay correct. */
+
+#define MS_PER_DAY     86400000L
+
+long PDC_millisecs(void)
+{
+    static long prev_ticks = 0L, day_offset = 0L;
+    const long ticks = getdosmemdword(0x46c);
+
+    if (ticks < prev_ticks)     /* midnight rollover */
+        day_offset += MS_PER_DAY;
+    prev_ticks = ticks;
+
+    return day_offset + (ticks / 859L) * 47181L
+                      + (ticks % 859L) * 47181L / 859L;
+}
+
 const char *PDC_sysname(void)
 {
     return "DOSVGA";
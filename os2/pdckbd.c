@@ -169,8 +169,7 @@ bool PDC_check_key(void)
 static int _process_mouse_events(void)
 {
     MOUEVENTINFO event;
-    static const USHORT button_mask[] = {6, 96, 24},
-                        move_mask[] = {2, 32, 8},
+    static const USHORT move_mask[] = {2, 32, 8},
                         press_mask[] = {4, 64, 16};
     USHORT count = 1;
     short shift_flags = 0;
@@ -194,30 +193,6 @@ static int _process_mouse_events(void)
         {
             SP->mouse_status.button[i] = BUTTON_PRESSED;
         }
-
-        if (SP->mouse_status.button[i] == BUTTON_PRESSED && SP->mouse_wait)
-        {
-            /* Check for a click -- a PRESS followed immediately by a
-               release */
-
-            if (!mouse_events)
-            {
-                MOUQUEINFO queue;
-
-                napms(SP->mouse_wait);
-
-                MouGetNumQueEl(&queue, mouse_handle);
-                mouse_events = queue.cEvents;
-            }
-
-            if (mouse_events)
-            {
-                MouReadEventQue(&event, &count, mouse_handle);
-
-                if (!(event.fs & button_mask[i]))
-                    SP->mouse_status.button[i] = BUTTON_CLICKED;
-            }
-        }
     }
 
     SP->mouse_status.x = event.col;
@@ -285,6 +260,26 @@ static int _process_mouse_events(void)
 
 #endif
 
+/* Wait for a key or mouse event, or for ms milliseconds (ms < 0:
+   forever). The keyboard and mouse are polled every 10 ms. */
+
+bool PDC_wait_for_input(int ms)
+{
+    const long start = PDC_millisecs();
+
+    while (!PDC_check_key())
+    {
+        long remaining = ms - (PDC_millisecs() - start);
+
+        if (ms >= 0 && remaining <= 0)
+            return FALSE;
+
+        PDC_napms((ms < 0 || remaining > 10) ? 10 : (int)remaining);
+    }
+
+    return TRUE;
+}
+
 /* return the next available key or mouse event */
 
 int PDC_get_key(void)
@@ -445,6 +440,13 @@ void PDC_flushinp(void)
 #endif
 }
 
+/* keyboard and mouse input don't come from a file descriptor */
+
+int PDC_get_input_fd(void)
+{
+    return -1;
+}
+
 bool PDC_has_mouse(void)
 {
     if (!mouse_handle)
@@ -2,6 +2,8 @@
 
 #include "pdcos2.h"
 
+#include <time.h>
+
 #if defined(OS2) && !defined(__EMX__)
 APIRET APIENTRY DosSleep(ULONG ulTime);
 #endif
@@ -28,6 +30,18 @@ void PDC_napms(int ms)
 #endif
 }
 
+long PDC_millisecs(void)
+{
+#if defined(EMXVIDEO) || defined(_MSC_VER)
+    return (long)(clock() * 1000. / CLOCKS_PER_SEC);
+#else
+    ULONG ms;
+
+    DosQuerySysInfo(QSV_MS_COUNT, QSV_MS_COUNT, &ms, sizeof(ms));
+    return (long)ms;
+#endif
+}
+
 const char *PDC_sysname(void)
 {
     return "OS/2";
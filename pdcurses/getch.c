@@ -23,6 +23,11 @@ getch
     int mvwget_wch(WINDOW *win, int y, int x, wint_t *wch);
     int unget_wch(const wchar_t wch);
 
+    int PDC_get_events(PDC_EVENT *events, int max, int timeout);
+    int PDC_get_input_fd(void);
+    int PDC_process_input(void);
+    int PDC_coalesce_events(bool flag);
+    unsigned long PDC_dropped_events(void);
     unsigned long PDC_get_key_modifiers(void);
     int PDC_return_key_modifiers(bool flag);
 
@@ -67,6 +72,46 @@ getch
    return modifier keys pressed alone as keystrokes (KEY_ALT_L, etc.).
    These may not work on all platforms.
 
+   PDC_get_events() returns all the input waiting, up to max events, in
+   one call, so that a program can deal with a burst of input (a run of
+   mouse movements, say) before redrawing once. Each PDC_EVENT has a
+   type (PDC_EVENT_KEY, PDC_EVENT_MOUSE or PDC_EVENT_RESIZE), the key
+   as wgetch() would return it (KEY_MOUSE and KEY_RESIZE for the last
+   two types), a key_code flag that's TRUE for function keys, the
+   keyboard modifiers and, for mouse events, the mouse status that
+   getmouse() would return for it. Mouse events are filtered and clicks
+   in the slk area translated as in wgetch(), but function keys are
+   returned whatever the keypad() setting, and there's no echoing or
+   line buffering. If no input is waiting, it waits up to timeout
+   milliseconds for some (forever, if timeout is negative). It returns
+   the number of events stored, 0 if none arrived in time, or ERR.
+
+   PDC_get_input_fd() returns a file descriptor that becomes readable
+   when there may be input, so that curses input can be part of a
+   program's own event loop (select(), poll(), epoll, libuv and so on):
+   stdin in the VT port, the X server connection in X11, and in SDL2,
+   the X server connection where SDL uses X11, or otherwise a pipe that
+   is written to whenever SDL queues an event. It returns -1 where
+   there's no such descriptor. When it becomes readable, call
+   PDC_process_input(), which reads and decodes whatever input is
+   available, without waiting, and returns the number of events now
+   queued (some of which may yet be filtered out); fetch them with
+   PDC_get_events(), with a timeout of 0. Input can be read ahead of
+   what's been fetched, so keep calling PDC_process_input() and fetching
+   events until it returns 0, before waiting on the descriptor again.
+   While a mouse click is held back to see if it's a double click (see
+   mouseinterval()), it's only delivered by a later call, so the loop
+   should also wake up after that interval.
+
+   PDC_coalesce_events(TRUE) turns on coalescing of input floods: while
+   a mouse motion event (with REPORT_MOUSE_POSITION, or a drag) is
+   still waiting to be read, a further one with the same button state
+   replaces it, and likewise for a KEY_RESIZE that's still waiting. So
+   a program that can't keep up sees only the latest position or size,
+   rather than redrawing for each step. It's off by default.
+   PDC_dropped_events() returns the number of events discarded this
+   way so far.
+
    NOTE: getch() and ungetch() are implemented as macros, to avoid
    conflict with many DOS compiler's runtime libraries.
 
@@ -88,11 +133,17 @@ getch
     mvget_wch                   Y       Y       Y
     mvwget_wch                  Y       Y       Y
     unget_wch                   Y       Y       Y
+    PDC_get_events              -       -       -
+    PDC_get_input_fd            -       -       -
+    PDC_process_input           -       -       -
+    PDC_coalesce_events         -       -       -
+    PDC_dropped_events          -       -       -
     PDC_get_key_modifiers       -       -       -
 
 **man-end****************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 
 static int _get_box(int *y_start, int *y_end, int *x_start, int *x_end)
 {
@@ -191,16 +242,55 @@ static void _copy(void)
 #endif
 }
 
+/* Push a block of keys onto the ungetch() stack all at once, so that
+   they're returned next, one at a time. Returns the first key, for the
+   caller to return, or -1 if there are none, or no room for them. */
+
+static int _unget_keys(const int *keys, long n)
+{
+    long newmax;
+    int key;
+
+    if (n <= 0)
+        return -1;
+
+    newmax = n - 1 + SP->c_ungind;
+    if (newmax > SP->c_ungmax)
+    {
+        int *new_ungch = realloc(SP->c_ungch, newmax * sizeof(int));
+
+        if (!new_ungch)
+            return -1;
+        SP->c_ungch = new_ungch;
+        SP->c_ungmax = newmax;
+    }
+
+    /* the stack is popped from the top, so the keys go in backwards;
+       CRs are translated as wgetch() would */
+
+    while (--n >= 0)
+    {
+        key = keys[n];
+        if (key == '\r' && SP->autocr && !SP->raw_inp)
+            key = '\n';
+        if (n)
+            SP->c_ungch[SP->c_ungind++] = key;
+    }
+
+    return key;
+}
+
 static int _paste(void)
 {
 #ifdef PDC_WIDE
     wchar_t *wpaste;
 # define PASTE wpaste
 #else
-# define PASTE paste
+# define PASTE ((unsigned char *)paste)
 #endif
     char *paste;
-    long len, newmax;
+    int *keys;
+    long i, len;
     int key;
 
     key = PDC_getclipboard(&paste, &len);
@@ -208,23 +298,23 @@ static int _paste(void)
         return -1;
 
 #ifdef PDC_WIDE
-    wpaste = malloc(len * sizeof(wchar_t));
-    len = (long)PDC_mbstowcs(wpaste, paste, len);
+    wpaste = malloc((len + 1) * sizeof(wchar_t));
+    len = wpaste ? (long)PDC_mbstowcs(wpaste, paste, len) : -1;
 #endif
-    newmax = len + SP->c_ungind;
-    if (newmax > SP->c_ungmax)
+    keys = (len > 0 ? malloc(len * sizeof(int)) : NULL);
+    if (keys)
     {
-        SP->c_ungch = realloc(SP->c_ungch, newmax * sizeof(int));
-        if (!SP->c_ungch)
-            return -1;
-        SP->c_ungmax = newmax;
+        for (i = 0; i < len; i++)
+            keys[i] = PASTE[i];
+        key = _unget_keys(keys, len);
+        free(keys);
     }
-    while (len > 1)
-        PDC_ungetch(PASTE[--len]);
-    key = *PASTE;
+    else
+        key = -1;
 #ifdef PDC_WIDE
     free(wpaste);
 #endif
+#undef PASTE
     PDC_freeclipboard(paste);
     SP->key_modifiers = 0;
 
@@ -335,11 +425,233 @@ static int _mouse_key(void)
     return key;
 }
 
+/* Input events taken from the port, waiting to be returned by wgetch()
+   or PDC_get_events(). Each one carries its own mouse status, key code
+   flag and modifiers, so a run of mouse events can be queued up without
+   each overwriting SP->mouse_status. While the port is being read,
+   SP->mouse_status holds the port's own view of the mouse (the last
+   event it reported, in port_mouse_status); the program's view is put
+   back afterwards. */
+
+#define EVENT_QUEUE_SIZE 256        /* must be a power of two */
+
+static PDC_EVENT event_queue[EVENT_QUEUE_SIZE];
+static unsigned event_head = 0, event_tail = 0;
+
+/* Keys pasted in all at once, handed over by the port through
+   PDC_paste_keys(). They're attached to the queue slot of the event for
+   the first one (in pastes[]), so they keep their place in the queue,
+   and handed out from there (see _get_event()). */
+
+typedef struct
+{
+    int *keys;
+    long len, pos;
+} PASTE;
+
+static PASTE pastes[EVENT_QUEUE_SIZE], port_paste;
+
+static MOUSE_STATUS port_mouse_status;
+static bool coalesce_events = FALSE;
+static unsigned long dropped_events = 0;
+
+/* Can the event the port just returned (described by 'key' and SP)
+   replace 'prev', which is still waiting? Only motion events with the
+   same button state, and resizes, are coalesced. */
+
+static bool _coalesces(const PDC_EVENT *prev, int key)
+{
+    const MOUSE_STATUS *status = &SP->mouse_status;
+
+    if (!SP->key_code || !prev->key_code || prev->key != key)
+        return FALSE;
+
+    if (key == KEY_RESIZE)
+        return TRUE;
+
+    return key == KEY_MOUSE &&
+           (status->changes & (PDC_MOUSE_MOVED | PDC_MOUSE_POSITION)) &&
+           status->changes == prev->mouse.changes &&
+           !memcmp(status->button, prev->mouse.button,
+                   sizeof(status->button));
+}
+
+/* Move whatever input the port has ready -- and any mouse click that's
+   due -- into the queue, without waiting. Raw mouse presses and
+   releases are turned into clicks here. */
+
+static void _queue_port_events(void)
+{
+    const MOUSE_STATUS mouse_status = SP->mouse_status;
+    const unsigned long key_modifiers = SP->key_modifiers;
+    const bool key_code = SP->key_code;
+
+    SP->mouse_status = port_mouse_status;
+
+    while (event_tail - event_head < EVENT_QUEUE_SIZE)
+    {
+        PDC_EVENT *event;
+        int key;
+
+        if (!PDC_mouse_timeout())
+        {
+            key = PDC_mouse_timed_event();
+            SP->key_code = TRUE;
+            SP->key_modifiers = 0;
+        }
+        else if (PDC_check_key())
+        {
+            key = PDC_get_key();
+            if (SP->key_code && key == KEY_MOUSE)
+                key = PDC_mouse_event();
+        }
+        else
+            break;
+
+        if (key == -1)
+            continue;
+
+        event = event_queue + ((event_tail - 1) & (EVENT_QUEUE_SIZE - 1));
+        if (coalesce_events && event_tail != event_head &&
+            _coalesces(event, key))
+            dropped_events++;
+        else
+        {
+            const unsigned slot = event_tail++ & (EVENT_QUEUE_SIZE - 1);
+
+            event = event_queue + slot;
+            pastes[slot] = port_paste;
+            port_paste.keys = NULL;
+        }
+
+        event->key = key;
+        event->key_code = SP->key_code;
+        event->modifiers = SP->key_modifiers;
+        if (SP->key_code && key == KEY_MOUSE)
+        {
+            event->type = PDC_EVENT_MOUSE;
+            event->mouse = SP->mouse_status;
+        }
+        else if (SP->key_code && key == KEY_RESIZE)
+            event->type = PDC_EVENT_RESIZE;
+        else
+            event->type = PDC_EVENT_KEY;
+    }
+
+    port_mouse_status = SP->mouse_status;
+    SP->mouse_status = mouse_status;
+    SP->key_modifiers = key_modifiers;
+    SP->key_code = key_code;
+}
+
+/* Take the next event from the queue, refilling it from the port if
+   need be, and make it current: SP->key_code, SP->key_modifiers and
+   (for mouse events) SP->mouse_status are set from it. Returns FALSE if
+   there's none. */
+
+static bool _get_event(PDC_EVENT *event)
+{
+    PASTE *paste;
+    unsigned slot;
+
+    if (event_head == event_tail)
+    {
+        _queue_port_events();
+        if (event_head == event_tail)
+            return FALSE;
+    }
+
+    slot = event_head & (EVENT_QUEUE_SIZE - 1);
+    *event = event_queue[slot];
+    paste = pastes + slot;
+    if (!paste->keys)
+        event_head++;
+    else
+    {
+        /* Without line buffering or echo, the rest of the paste goes
+           onto the ungetch() stack in one go, for wgetch() to return
+           straight from there. Otherwise (or if the stack can't be made
+           big enough), the keys have to go through wgetch() one at a
+           time, so the slot stays at the head until the paste is used
+           up. */
+
+        event->key = paste->keys[paste->pos];
+        if ((SP->raw_inp || SP->cbreak) && !SP->echo &&
+            _unget_keys(paste->keys + paste->pos,
+                        paste->len - paste->pos) != -1)
+            paste->pos = paste->len;
+        else
+            paste->pos++;
+
+        if (paste->pos == paste->len)
+        {
+            free(paste->keys);
+            paste->keys = NULL;
+            event_head++;
+        }
+    }
+    SP->key_code = event->key_code;
+    SP->key_modifiers = event->modifiers;
+    if (event->type == PDC_EVENT_MOUSE)
+        SP->mouse_status = event->mouse;
+
+    return TRUE;
+}
+
+/* Handle copy and paste keys, filter mouse events and translate mouse
+   clicks in the slk area to function keys. Returns -1 if the key is to
+   be dropped. */
+
+static int _process_key(int key)
+{
+    /* copy or paste? */
+
+    if (SP->key_modifiers & PDC_KEY_MODIFIER_SHIFT)
+    {
+        if (0x03 == key)
+        {
+            _copy();
+            return -1;
+        }
+        else if (0x16 == key)
+            key = _paste();
+    }
+
+    if (SP->key_code && key == KEY_MOUSE)
+        key = _mouse_key();
+
+    return key;
+}
+
 #define WAIT_FOREVER    -1
 
+/* Sleep until input arrives, a held mouse click is due, or 'deadline'
+   (if 'millisecs' isn't WAIT_FOREVER) passes. Returns FALSE if the time
+   was already up. */
+
+static bool _wait_for_event(int millisecs, long deadline)
+{
+    const int mouse_millisecs = PDC_mouse_timeout();
+
+    if (millisecs != WAIT_FOREVER)
+    {
+        millisecs = (int)(deadline - PDC_millisecs());
+        if (millisecs <= 0)
+            return FALSE;
+    }
+    if (mouse_millisecs >= 0 && (millisecs == WAIT_FOREVER
+                                 || mouse_millisecs < millisecs))
+        millisecs = mouse_millisecs;
+    PDC_wait_for_input(millisecs);
+
+    return TRUE;
+}
+
 int wgetch(WINDOW *win)
 {
     int key, remaining_millisecs;
+    long deadline;
+
 
     PDC_LOG(("wgetch() - called\n"));
 
@@ -354,6 +666,7 @@ int wgetch(WINDOW *win)
         remaining_millisecs = win->_delayms;
     if( !remaining_millisecs && !win->_nodelay)
         remaining_millisecs = WAIT_FOREVER;
+    deadline = PDC_millisecs() + remaining_millisecs;
 
     /* refresh window when wgetch is called if there have been changes
        to it and it is not a pad */
@@ -382,47 +695,25 @@ int wgetch(WINDOW *win)
 
     for (;;)            /* loop for any buffering */
     {
-        /* is there a keystroke ready? */
+        PDC_EVENT event;
 
-        if (!PDC_check_key())
-        {
-            /* if not, handle timeout() and halfdelay() */
-            int nap_time = 50;
-
-            if (remaining_millisecs != WAIT_FOREVER)
-            {
-                if (!remaining_millisecs)
-                    return ERR;
-                if( nap_time > remaining_millisecs)
-                    nap_time = remaining_millisecs;
-                remaining_millisecs -= nap_time;
-            }
-            napms( nap_time);
-            continue;   /* then check again */
-        }
+        /* is there input waiting? if not, handle timeout() and
+           halfdelay(), and sleep until there is or the time is up */
 
-        /* if there is, fetch it */
-
-        key = PDC_get_key();
+        if (!_get_event(&event))
+        {
+            /* the input has all been read, so finish off any update
+               that doupdate() cut short for it (see typeahead()) */
 
-        /* copy or paste? */
+            if (is_wintouched(curscr))
+                doupdate();
 
-        if (SP->key_modifiers & PDC_KEY_MODIFIER_SHIFT)
-        {
-            if (0x03 == key)
-            {
-                _copy();
-                continue;
-            }
-            else if (0x16 == key)
-                key = _paste();
+            if (!_wait_for_event(remaining_millisecs, deadline))
+                return ERR;
+            continue;   /* then check again */
         }
 
-        /* filter mouse events; translate mouse clicks in the slk
-           area to function keys */
-
-        if (SP->key_code && key == KEY_MOUSE)
-            key = _mouse_key();
+        key = _process_key(event.key);
 
         /* filter special keys if not in keypad mode */
 
@@ -474,6 +765,142 @@ int wgetch(WINDOW *win)
     }
 }
 
+int PDC_get_events(PDC_EVENT *events, int max, int timeout)
+{
+    long deadline;
+    int n = 0;
+
+    PDC_LOG(("PDC_get_events() - called: max %d timeout %d\n",
+             max, timeout));
+
+    assert( SP);
+    if (!SP || !events || max < 1)
+        return ERR;
+
+    if (timeout < 0)
+        timeout = WAIT_FOREVER;
+    deadline = PDC_millisecs() + timeout;
+
+    while (n < max)
+    {
+        PDC_EVENT *event = events + n;
+        int key;
+
+        if (SP->c_ungind)       /* ungotten keys come first */
+        {
+            key = SP->c_ungch[--(SP->c_ungind)];
+            event->type = PDC_EVENT_KEY;
+            event->key = key;
+            event->key_code = (key >= KEY_MIN && key <= KEY_MAX);
+            event->modifiers = 0;
+        }
+        else if (_get_event(event))
+        {
+            key = _process_key(event->key);
+            if (key == -1)
+                continue;
+            if (key == KEY_MOUSE && SP->key_code)
+                event->mouse = SP->mouse_status;    /* as filtered */
+            else
+            {
+                /* a key, a click in the slk area, or a paste */
+
+                if (key == '\r' && SP->autocr && !SP->raw_inp)
+                    key = '\n';
+                if (event->type == PDC_EVENT_MOUSE)
+                    event->type = PDC_EVENT_KEY;
+                event->key = key;
+                event->key_code = SP->key_code;
+            }
+        }
+        else if (n)
+            break;
+        else
+        {
+            /* finish off any update cut short for typeahead before
+               waiting, as wgetch() does */
+
+            if (is_wintouched(curscr))
+                doupdate();
+
+            if (!_wait_for_event(timeout, deadline))
+                break;
+            continue;
+        }
+
+        n++;
+    }
+
+    if (n)
+    {
+        if (_highlight())
+            wrefresh(curscr);
+        SP->sel_start = SP->sel_end = -1;
+    }
+
+    return n;
+}
+
+/* Called from the port's PDC_get_key() with a block of keys pasted in
+   all at once, allocated with malloc(), which the core takes over. The
+   keys are returned in order, starting with keys[0], which is returned
+   here for PDC_get_key() to return; the rest follow it as a batch. */
+
+int PDC_paste_keys(int *keys, long n)
+{
+    int key = (n > 0 ? keys[0] : -1);
+
+    free(port_paste.keys);
+    port_paste.keys = NULL;
+    if (n > 1)
+    {
+        port_paste.keys = keys;
+        port_paste.len = n;
+        port_paste.pos = 0;
+    }
+    else
+        free(keys);
+
+    return key;
+}
+
+/* Used by doupdate() to see if it should give way to typeahead; doesn't
+   take anything from the port, so it's cheap enough to call often */
+
+bool PDC_input_pending(void)
+{
+    return event_head != event_tail || PDC_check_key();
+}
+
+int PDC_process_input(void)
+{
+    PDC_LOG(("PDC_process_input() - called\n"));
+
+    assert( SP);
+    if (!SP)
+        return ERR;
+
+    _queue_port_events();
+
+    return (int)(event_tail - event_head) + SP->c_ungind;
+}
+
+int PDC_coalesce_events(bool flag)
+{
+    PDC_LOG(("PDC_coalesce_events() - called\n"));
+
+    coalesce_events = flag;
+
+    return OK;
+}
+
+unsigned long PDC_dropped_events(void)
+{
+    PDC_LOG(("PDC_dropped_events() - called\n"));
+
+    return dropped_events;
+}
+
 int mvgetch(int y, int x)
 {
     PDC_LOG(("mvgetch() - called\n"));
@@ -516,6 +943,16 @@ int flushinp(void)
 
     PDC_flushinp();
 
+    while (event_head != event_tail)
+    {
+        PASTE *paste = pastes + (event_head++ & (EVENT_QUEUE_SIZE - 1));
+
+        free(paste->keys);
+        paste->keys = NULL;
+    }
+    free(port_paste.keys);
+    port_paste.keys = NULL;
+
     SP->c_gindex = 1;       /* set indices to kill buffer */
     SP->c_pindex = 0;
     SP->c_ungind = 0;       /* clear SP->c_ungch array */
@@ -17,6 +17,7 @@ initscr
     SCREEN *newterm(const char *type, FILE *outfd, FILE *infd);
     SCREEN *set_term(SCREEN *new);
     void delscreen(SCREEN *sp);
+    int use_screen(SCREEN *scr, NCURSES_SCREEN_CB func, void *data);
 
     int resize_term(int nlines, int ncols);
     bool is_termresized(void);
@@ -50,6 +51,18 @@ initscr
    needed. In PDCurses, the parameter must be the value of SP, and
    delscreen() sets SP to NULL.
 
+   use_screen() calls func(scr, data) with the screen locked, and
+   returns whatever func returns. In a build with PDC_THREADSAFE, the
+   same lock is taken by doupdate(), wnoutrefresh() and pnoutrefresh(),
+   so that worker threads can draw into windows of their own (see
+   use_window()) while the screen is updated from the others. Anything
+   else that involves the screen as a whole -- input, creating or
+   deleting windows, changing modes or colors -- should be done from one
+   thread, or inside use_screen(). The screen lock is always taken
+   before a window's, so func may call use_window(), but not the other
+   way around. PDCurses has only one screen, so scr is always SP. Without
+   PDC_THREADSAFE, use_screen() just calls func.
+
    set_term() does nothing meaningful in PDCurses, but is included for
    compatibility with other curses implementations.
 
@@ -91,6 +104,7 @@ initscr
     newterm                     Y       Y       Y
     set_term                    Y       Y       Y
     delscreen                   Y       Y       Y
+    use_screen                  -       Y       -
     resize_term                 -       Y       Y
     set_tabsize                 -       Y       Y
     curses_version              -       Y       -
@@ -296,6 +310,22 @@ SCREEN *newterm(const char *type, FILE *outfd, FILE *infd)
     return initscr() ? SP : NULL;
 }
 
+int use_screen(SCREEN *scr, NCURSES_SCREEN_CB func, void *data)
+{
+    int rval;
+
+    PDC_LOG(("use_screen() - called\n"));
+
+    if (!scr || !func)
+        return ERR;
+
+    PDC_lock_screen();
+    rval = func(scr, data);
+    PDC_unlock_screen();
+
+    return rval;
+}
+
 SCREEN *set_term(SCREEN *new)
 {
     PDC_LOG(("set_term() - called\n"));
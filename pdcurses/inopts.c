@@ -84,9 +84,21 @@ inopts
    delay is given; i.e., 1-99 will wait 50ms, 100-149 will wait 100ms,
    etc.
 
-   intrflush(), notimeout(), noqiflush(), qiflush() and typeahead() do
-   nothing in PDCurses, but are included for compatibility with other
-   curses implementations.
+   typeahead() controls whether doupdate() checks for pending input
+   while it updates the screen. If it's on, and keys (or other input)
+   are waiting, doupdate() stops early, leaving the rest of the changes
+   to be sent on the next refresh -- so that, e.g., a held-down key
+   doesn't leave the program painting a backlog of stale screens. Pass
+   -1 to turn the check off; any other value turns it on. (In other
+   curses, fildes is the file descriptor to check; PDCurses always
+   checks its own input.) Initially, the check is on in the VT port,
+   as it is in terminal curses, and off elsewhere, where any input
+   event, mouse motion included, would count. It's never done for a
+   full redraw, such as after clearok() or endwin().
+
+   intrflush(), notimeout(), noqiflush() and qiflush() do nothing in
+   PDCurses, but are included for compatibility with other curses
+   implementations.
 
    crmode() and nocrmode() are archaic equivalents to cbreak() and
    nocbreak(), respectively.
@@ -310,6 +322,12 @@ int typeahead(int fildes)
 {
     PDC_LOG(("typeahead() - called\n"));
 
+    assert( SP);
+    if (!SP)
+        return ERR;
+
+    SP->check_typeahead = (fildes != -1);
+
     return OK;
 }
 
@@ -70,18 +70,20 @@ mouse
 
    mouseinterval() sets the timeout for a mouse click. On all current
    platforms, PDCurses receives mouse button press and release events,
-   but must synthesize click events. It does this by checking whether a
-   release event is queued up after a press event. If it gets a press
-   event, and there are no more events waiting, it will wait for the
-   timeout interval, then check again for a release. A press followed by
-   a release is reported as BUTTON_CLICKED; otherwise it's passed
-   through as BUTTON_PRESSED. The default timeout is 150ms; valid values
-   are 0 (no clicks reported) through 1000ms. In x11, the timeout can
-   also be set via the clickPeriod resource. The return value from
-   mouseinterval() is the old timeout. To check the old value without
-   setting a new one, call it with a parameter of -1. Note that although
-   there's no classic equivalent for this function (apart from the
-   clickPeriod resource), the value set applies in both interfaces.
+   but must synthesize click events. A press is always reported as
+   BUTTON_PRESSED when it happens. If clicks are trapped, a release
+   within the timeout interval of the press is reported as
+   BUTTON_CLICKED instead of BUTTON_RELEASED, and a further press within
+   the interval of that makes it a double (then triple) click. When
+   double or triple clicks are trapped, a click is only reported once
+   the interval has passed without another press; getch() never waits
+   longer than its own timeout for this. The default timeout is 150ms;
+   valid values are 0 (no clicks reported) through 1000ms. In x11, the
+   timeout can also be set via the clickPeriod resource. The return
+   value from mouseinterval() is the old timeout. To check the old value
+   without setting a new one, call it with a parameter of -1. Note that
+   although there's no classic equivalent for this function (apart from
+   the clickPeriod resource), the value set applies in both interfaces.
 
    wenclose() reports whether the given screen-relative y, x coordinates
    fall within the given window.
@@ -216,6 +218,204 @@ mmask_t getmouse(void)
     return SP ? SP->_trap_mbe : (mmask_t)0;
 }
 
+/* Click synthesis
+
+   Ports report button presses and releases as they happen. For each
+   KEY_MOUSE from the port, wgetch() calls PDC_mouse_event(), which
+   pairs them up into clicks without ever waiting:
+
+   - a press is reported at once;
+   - if the program has asked for clicks of that button, a release that
+     comes within SP->mouse_wait ms of the press is reported as a click
+     instead, and another press within SP->mouse_wait of that release
+     makes it a double (then triple) click;
+   - a click that could still become a double or triple click -- one
+     the program has asked for -- is held until SP->mouse_wait ms pass
+     without another press, or until some other mouse event comes in.
+
+   PDC_mouse_timeout() tells wgetch() how long it may sleep before a
+   held click is due; PDC_mouse_timed_event() then reports it. */
+
+#define BUTTON_SHIFT_BITS     5     /* bits per button in an mmask_t */
+
+static struct
+{
+    int button;             /* button being clicked, or -1 if none */
+    int count;              /* clicks so far */
+    bool down;              /* button is still down */
+    long time;              /* time of the last press or release */
+    MOUSE_STATUS status;    /* status to report for the click */
+} click = { -1, 0, FALSE, 0L, { 0 } };
+
+static MOUSE_STATUS held_status;    /* event that came in while a click */
+static bool held = FALSE;           /* was held; reported after it */
+
+/* The button (0-2) that was pressed or released, or -1 for any other
+   kind of event */
+
+static int _button_event(const MOUSE_STATUS *status)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (status->changes == (1 << i))
+        {
+            const short action = status->button[i] & BUTTON_ACTION_MASK;
+
+            return (action == BUTTON_PRESSED ||
+                    action == BUTTON_RELEASED) ? i : -1;
+        }
+
+    return -1;
+}
+
+static bool _trapped(const mmask_t mask, const int button)
+{
+    return !!(SP->_trap_mbe & (mask << (button * BUTTON_SHIFT_BITS)));
+}
+
+/* Put the held click in SP->mouse_status */
+
+static int _report_click(void)
+{
+    static const short action[4] = { BUTTON_RELEASED, BUTTON_CLICKED,
+                            BUTTON_DOUBLE_CLICKED, BUTTON_TRIPLE_CLICKED };
+    short *button = &click.status.button[click.button];
+
+    *button = (*button & BUTTON_MODIFIER_MASK) | action[click.count];
+    SP->mouse_status = click.status;
+    click.button = -1;
+
+    return KEY_MOUSE;
+}
+
+/* Report the held click now, and hold the event in SP->mouse_status
+   until it's been read */
+
+static int _report_click_first(void)
+{
+    held_status = SP->mouse_status;
+    held = TRUE;
+
+    return _report_click();
+}
+
+/* Called from wgetch() with a KEY_MOUSE from the port, described by
+   SP->mouse_status. Returns KEY_MOUSE if there's an event to report
+   (in SP->mouse_status), or -1 if not. */
+
+int PDC_mouse_event(void)
+{
+    const int button = _button_event(&SP->mouse_status);
+    const long now = PDC_millisecs();
+    const bool in_time = (now - click.time <= SP->mouse_wait);
+    short action;
+
+    if (button < 0)
+    {
+        /* moving the mouse with no button down doesn't spoil a click */
+
+        if (!(SP->mouse_status.changes & ~(PDC_MOUSE_MOVED |
+                                           PDC_MOUSE_POSITION)))
+            return KEY_MOUSE;
+
+        if (click.button >= 0 && click.count)
+            return _report_click_first();
+
+        click.button = -1;
+        return KEY_MOUSE;
+    }
+
+    action = SP->mouse_status.button[button] & BUTTON_ACTION_MASK;
+
+    if (action == BUTTON_PRESSED)
+    {
+        if (click.button == button && click.count && !click.down &&
+            in_time)
+        {
+            /* on the way to a double or triple click */
+
+            click.down = TRUE;
+            click.time = now;
+        }
+        else if (click.button >= 0 && click.count)
+            return _report_click_first();
+        else if (SP->mouse_wait &&
+                 _trapped(BUTTON1_CLICKED | BUTTON1_DOUBLE_CLICKED, button))
+        {
+            click.button = button;
+            click.count = 0;
+            click.down = TRUE;
+            click.time = now;
+        }
+        else
+            click.button = -1;
+
+        return KEY_MOUSE;
+    }
+
+    /* BUTTON_RELEASED */
+
+    if (click.button != button)
+        return KEY_MOUSE;
+
+    if (!click.down || !in_time)
+    {
+        if (click.count)
+            return _report_click_first();
+
+        click.button = -1;
+        return KEY_MOUSE;
+    }
+
+    click.count++;
+    click.down = FALSE;
+    click.time = now;
+    click.status = SP->mouse_status;
+
+    /* hold it if it might turn into a double or triple click */
+
+    if ((click.count == 1 && _trapped(BUTTON1_DOUBLE_CLICKED, button)) ||
+        (click.count == 2 && _trapped(BUTTON1_TRIPLE_CLICKED, button)))
+        return -1;
+
+    return _report_click();
+}
+
+/* Milliseconds until a held click is due to be reported: 0 if it's due
+   now, or an event is waiting behind it; -1 if nothing is held */
+
+int PDC_mouse_timeout(void)
+{
+    long remaining;
+
+    if (held)
+        return 0;
+
+    if (click.button < 0 || !click.count)
+        return -1;
+
+    remaining = click.time + SP->mouse_wait - PDC_millisecs();
+
+    return (remaining > 0) ? (int)remaining : 0;
+}
+
+/* Called from wgetch() when PDC_mouse_timeout() returns 0. Returns as
+   PDC_mouse_event() does. */
+
+int PDC_mouse_timed_event(void)
+{
+    if (held)
+    {
+        held = FALSE;
+        SP->mouse_status = held_status;
+
+        return PDC_mouse_event();
+    }
+
+    return (click.button >= 0) ? _report_click() : -1;
+}
+
 /* ncurses mouse interface */
 
 const int max_mouse_interval = 32767;        /* 32.767 seconds */
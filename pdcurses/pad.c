@@ -201,6 +201,9 @@ int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
 
     num_cols = min((sx2 - sx1 + 1), (w->_maxx - px));
 
+    PDC_lock_screen();
+    PDC_lock_window(w);
+
     while (sline <= sy2)
     {
         if (pline < w->_maxy)
@@ -240,6 +243,9 @@ int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
         curscr->_curx = (w->_curx - px) + sx1;
     }
 
+    PDC_unlock_window(w);
+    PDC_unlock_screen();
+
     return OK;
 }
 
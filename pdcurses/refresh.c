@@ -37,6 +37,10 @@ refresh
    calling wnoutrefresh() for each window, it is then possible to call
    doupdate() only once.
 
+   If input is waiting, doupdate() may stop before the update is done,
+   leaving the rest for the next refresh, or for when wgetch() runs out
+   of input; see typeahead().
+
    In PDCurses, redrawwin() is equivalent to touchwin(), and wredrawln()
    is the same as touchline(). In some other curses implementations,
    there's a subtle distinction, but it has no meaning in PDCurses.
@@ -68,6 +72,9 @@ int wnoutrefresh(WINDOW *win)
     if ( !win || (win->_flags & (_PAD|_SUBPAD)) )
         return ERR;
 
+    PDC_lock_screen();
+    PDC_lock_window(win);
+
     begy = win->_begy;
     begx = win->_begx;
 
@@ -123,12 +130,22 @@ int wnoutrefresh(WINDOW *win)
         curscr->_curx = win->_curx + begx;
     }
 
+    PDC_unlock_window(win);
+    PDC_unlock_screen();
+
     return OK;
 }
 
+/* With typeahead() on, doupdate() looks for pending input after every
+   TYPEAHEAD_INTERVAL changed lines, as ncurses does -- so some progress
+   is always made */
+
+#define TYPEAHEAD_INTERVAL 5
+
 int doupdate(void)
 {
-    int y;
+    static bool updating = FALSE;
+    int y, changed = 0;
     bool clearall;
 
     PDC_LOG(("doupdate() - called\n"));
@@ -138,6 +155,18 @@ int doupdate(void)
     if (!SP || !curscr)
         return ERR;
 
+    PDC_lock_screen();
+
+    /* the typeahead check can take us into the port, which may call
+       back here to redraw; the update in progress will do that */
+
+    if (updating)
+    {
+        PDC_unlock_screen();
+        return OK;
+    }
+    updating = TRUE;
+
     if (isendwin())         /* coming back after endwin() called */
     {
         reset_prog_mode();
@@ -155,10 +184,20 @@ int doupdate(void)
 
         if (clearall || curscr->_firstch[y] != _NO_CHANGE)
         {
-            int first, last;
-
             chtype *src = curscr->_y[y];
             chtype *dest = SP->lastscr->_y[y];
+            int first, last;
+
+            /* leave the rest for the next refresh if there's input
+               waiting; lines already sent stay sent */
+
+            if (!clearall && SP->check_typeahead && changed &&
+                !(changed % TYPEAHEAD_INTERVAL) && PDC_input_pending())
+            {
+                PDC_LOG(("doupdate() - stopped at line %d for input\n",
+                         y));
+                break;
+            }
 
             if (clearall)
             {
@@ -207,6 +246,7 @@ int doupdate(void)
 
             curscr->_firstch[y] = _NO_CHANGE;
             curscr->_lastch[y] = _NO_CHANGE;
+            changed++;
         }
     }
 
@@ -220,6 +260,9 @@ int doupdate(void)
 
     PDC_doupdate();
 
+    updating = FALSE;
+    PDC_unlock_screen();
+
     return OK;
 }
 
@@ -23,6 +23,7 @@ window
     void wsyncup(WINDOW *win);
     void wcursyncup(WINDOW *win);
     void wsyncdown(WINDOW *win);
+    int use_window(WINDOW *win, NCURSES_WINDOW_CB func, void *data);
 
     WINDOW *resize_window(WINDOW *win, int nlines, int ncols);
     int wresize(WINDOW *win, int nlines, int ncols);
@@ -77,6 +78,17 @@ window
    wsyncdown() causes a touchwin() of the current window if any of its
    parent's windows have been touched.
 
+   use_window() calls func(win, data) with win locked, and returns
+   whatever func returns. PDCurses built with PDC_THREADSAFE defined
+   (which needs POSIX threads) gives each window a lock of its own, so
+   that several threads can draw into different windows at once. The
+   window's lock is also taken by wnoutrefresh() and pnoutrefresh(), so
+   the screen isn't updated from a window that's halfway through being
+   drawn. Subwindows share their parent's lines, but not its lock; draw
+   into a window and its subwindows from one thread. Don't refresh,
+   create or delete windows from inside func; see use_screen(). Without
+   PDC_THREADSAFE, use_window() just calls func.
+
    resize_window() allows the user to resize an existing window. It
    returns the pointer to the new window, or NULL on failure.
 
@@ -124,6 +136,7 @@ window
     syncok                      Y       Y       Y
     wcursyncup                  Y       Y       Y
     wsyncdown                   Y       Y       Y
+    use_window                  -       Y       -
     wresize                     -       Y       Y
     resize_window               -       -       -
     PDC_makelines               -       -       -
@@ -134,6 +147,67 @@ window
 
 #include <stdlib.h>
 
+#ifdef PDC_THREADSAFE
+# include <pthread.h>
+
+static pthread_mutex_t screen_lock;
+static pthread_once_t screen_lock_once = PTHREAD_ONCE_INIT;
+
+/* The locks are recursive, so that curses functions which take them can
+   be called from inside use_screen() and use_window() */
+
+static int _init_lock(pthread_mutex_t *lock)
+{
+    pthread_mutexattr_t attr;
+    int rval;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    rval = pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return rval;
+}
+
+static void _init_screen_lock(void)
+{
+    _init_lock(&screen_lock);
+}
+
+static void _free_lock(WINDOW *win)
+{
+    if (win->_lock)
+    {
+        pthread_mutex_destroy(win->_lock);
+        free(win->_lock);
+        win->_lock = NULL;
+    }
+}
+
+void PDC_lock_screen(void)
+{
+    pthread_once(&screen_lock_once, _init_screen_lock);
+    pthread_mutex_lock(&screen_lock);
+}
+
+void PDC_unlock_screen(void)
+{
+    pthread_mutex_unlock(&screen_lock);
+}
+
+void PDC_lock_window(WINDOW *win)
+{
+    if (win && win->_lock)
+        pthread_mutex_lock(win->_lock);
+}
+
+void PDC_unlock_window(WINDOW *win)
+{
+    if (win && win->_lock)
+        pthread_mutex_unlock(win->_lock);
+}
+#endif
+
 WINDOW *PDC_makenew(int nlines, int ncols, int begy, int begx)
 {
     WINDOW *win;
@@ -175,6 +249,19 @@ WINDOW *PDC_makenew(int nlines, int ncols, int begy, int begx)
         return (WINDOW *)NULL;
     }
 
+#ifdef PDC_THREADSAFE
+    win->_lock = malloc(sizeof(pthread_mutex_t));
+    if (!win->_lock || _init_lock(win->_lock))
+    {
+        free(win->_lock);
+        free(win->_lastch);
+        free(win->_firstch);
+        free(win->_y);
+        free(win);
+        return (WINDOW *)NULL;
+    }
+#endif
+
     /* initialize window variables */
 
     win->_maxy = nlines;  /* real max screen size */
@@ -215,6 +302,9 @@ WINDOW *PDC_makelines(WINDOW *win)
             for (j = 0; j < i; j++)
                 free(win->_y[j]);
 
+#ifdef PDC_THREADSAFE
+            _free_lock(win);
+#endif
             free(win->_firstch);
             free(win->_lastch);
             free(win->_y);
@@ -279,6 +369,9 @@ int delwin(WINDOW *win)
             if (win->_y[i])
                 free(win->_y[i]);
 
+#ifdef PDC_THREADSAFE
+    _free_lock(win);
+#endif
     free(win->_firstch);
     free(win->_lastch);
     free(win->_y);
@@ -525,6 +618,10 @@ WINDOW *resize_window(WINDOW *win, int nlines, int ncols)
     free(win->_lastch);
     free(win->_y);
 
+#ifdef PDC_THREADSAFE
+    _free_lock(new);        /* the window keeps its own lock */
+    new->_lock = win->_lock;
+#endif
     *win = *new;
     free(new);
 
@@ -583,3 +680,19 @@ void wsyncdown(WINDOW *win)
         }
     }
 }
+
+int use_window(WINDOW *win, NCURSES_WINDOW_CB func, void *data)
+{
+    int rval;
+
+    PDC_LOG(("use_window() - called\n"));
+
+    if (!win || !func)
+        return ERR;
+
+    PDC_lock_window(win);
+    rval = func(win, data);
+    PDC_unlock_window(win);
+
+    return rval;
+}
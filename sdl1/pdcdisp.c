@@ -23,6 +23,222 @@ static int rectcount = 0;              /* index into uprect */
 static int foregr = -2, backgr = -2;   /* current foreground, background */
 static bool blinked_off = FALSE;
 
+#ifdef PDC_WIDE
+
+/* Rendered glyphs are cached, so that drawing a character again in the
+   same style and color is a single blit, rather than a trip through
+   SDL_ttf. Each glyph is kept, centered in a cell-sized slot, in one of
+   a few "atlas" surfaces; once they're full, the least recently used
+   glyph makes way for the new one. */
+
+#define GLYPH_ATLAS_COLS 32     /* slots across an atlas */
+#define GLYPH_ATLAS_ROWS 16     /* slots down an atlas */
+#define GLYPH_ATLASES    4
+#define GLYPHS_PER_ATLAS (GLYPH_ATLAS_COLS * GLYPH_ATLAS_ROWS)
+#define GLYPH_SLOTS      (GLYPHS_PER_ATLAS * GLYPH_ATLASES)
+#define GLYPH_HASH_SIZE  2048   /* must be a power of two */
+
+typedef struct
+{
+    Uint32 ch;              /* the character */
+    Uint32 rgb;             /* and its foreground color */
+    int style;              /* TTF_STYLE_* */
+    int hash_next;          /* next slot in the same bucket, or -1 */
+    int lru_prev, lru_next; /* slots used more/less recently, or -1 */
+} GLYPH;
+
+static GLYPH glyphs[GLYPH_SLOTS];
+static int glyph_hash[GLYPH_HASH_SIZE];
+static SDL_Surface *glyph_atlas[GLYPH_ATLASES];
+static int n_glyphs = -1;               /* -1 until initialized */
+static int lru_first = -1, lru_last = -1;
+static int glyph_w, glyph_h;            /* size of a slot */
+static int font_style = 0;              /* as set by _set_attr() */
+
+/* discard all cached glyphs, as when the font is changed or closed */
+
+void PDC_flush_glyphs(void)
+{
+    int i;
+
+    for (i = 0; i < GLYPH_ATLASES; i++)
+    {
+        SDL_FreeSurface(glyph_atlas[i]);
+        glyph_atlas[i] = NULL;
+    }
+
+    for (i = 0; i < GLYPH_HASH_SIZE; i++)
+        glyph_hash[i] = -1;
+
+    n_glyphs = 0;
+    lru_first = lru_last = -1;
+}
+
+static unsigned _glyph_bucket(Uint32 ch, Uint32 rgb, int style)
+{
+    return ((ch * 31 + rgb) * 2654435761u + (unsigned)style)
+           >> 8 & (GLYPH_HASH_SIZE - 1);
+}
+
+static void _lru_unlink(int i)
+{
+    if (glyphs[i].lru_prev == -1)
+        lru_first = glyphs[i].lru_next;
+    else
+        glyphs[glyphs[i].lru_prev].lru_next = glyphs[i].lru_next;
+
+    if (glyphs[i].lru_next == -1)
+        lru_last = glyphs[i].lru_prev;
+    else
+        glyphs[glyphs[i].lru_next].lru_prev = glyphs[i].lru_prev;
+}
+
+static void _lru_push(int i)
+{
+    glyphs[i].lru_prev = -1;
+    glyphs[i].lru_next = lru_first;
+
+    if (lru_first == -1)
+        lru_last = i;
+    else
+        glyphs[lru_first].lru_prev = i;
+
+    lru_first = i;
+}
+
+/* take the least recently used slot out of the cache, and return it */
+
+static int _evict_glyph(void)
+{
+    int i = lru_last;
+    int *link = glyph_hash + _glyph_bucket(glyphs[i].ch, glyphs[i].rgb,
+                                           glyphs[i].style);
+
+    while (*link != i)
+        link = &glyphs[*link].hash_next;
+
+    *link = glyphs[i].hash_next;
+    _lru_unlink(i);
+
+    return i;
+}
+
+static void _glyph_slot(int i, SDL_Rect *slot)
+{
+    slot->x = i % GLYPH_ATLAS_COLS * glyph_w;
+    slot->y = i % GLYPHS_PER_ATLAS / GLYPH_ATLAS_COLS * glyph_h;
+    slot->w = glyph_w;
+    slot->h = glyph_h;
+}
+
+/* render a glyph into a free (or freed) slot; returns the slot, or -1 */
+
+static int _add_glyph(Uint32 ch, Uint32 rgb, unsigned bucket)
+{
+    SDL_Surface *rendered;
+    SDL_Rect src, dest;
+    Uint16 chstr[2] = {0, 0};
+    int i, atlas;
+
+    if (TTF_GetFontStyle(pdc_ttffont) != font_style)
+        TTF_SetFontStyle(pdc_ttffont, font_style);
+
+    chstr[0] = (Uint16)ch;
+    rendered = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
+                                         pdc_color[foregr]);
+    if (!rendered)
+        return -1;
+
+    i = (n_glyphs < GLYPH_SLOTS) ? n_glyphs : _evict_glyph();
+    atlas = i / GLYPHS_PER_ATLAS;
+
+    if (!glyph_atlas[atlas])
+    {
+        glyph_atlas[atlas] = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            GLYPH_ATLAS_COLS * glyph_w, GLYPH_ATLAS_ROWS * glyph_h, 32,
+            0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+
+        if (!glyph_atlas[atlas])
+        {
+            SDL_FreeSurface(rendered);
+            return -1;
+        }
+    }
+
+    if (i == n_glyphs)
+        n_glyphs++;
+
+    /* copy the glyph, alpha and all, centered in its slot */
+
+    _glyph_slot(i, &dest);
+    SDL_FillRect(glyph_atlas[atlas], &dest, 0);
+
+    src.x = 0;
+    src.y = 0;
+    src.w = min(rendered->w, glyph_w);
+    src.h = min(rendered->h, glyph_h);
+
+    if (glyph_w > rendered->w)
+        dest.x += (glyph_w - rendered->w) >> 1;
+
+    SDL_SetAlpha(rendered, 0, SDL_ALPHA_OPAQUE);
+    SDL_BlitSurface(rendered, &src, glyph_atlas[atlas], &dest);
+    SDL_FreeSurface(rendered);
+
+    glyphs[i].ch = ch;
+    glyphs[i].rgb = rgb;
+    glyphs[i].style = font_style;
+    glyphs[i].hash_next = glyph_hash[bucket];
+    glyph_hash[bucket] = i;
+    _lru_push(i);
+
+    return i;
+}
+
+/* find (or render) the glyph for ch in the current style and foreground
+   color; returns the atlas it's in, with its location in *slot */
+
+static SDL_Surface *_get_glyph(chtype ch, SDL_Rect *slot)
+{
+    SDL_Color fg = pdc_color[foregr];
+    Uint32 rgb = ((Uint32)fg.r << 16) | ((Uint32)fg.g << 8) | fg.b;
+    unsigned bucket;
+    int i;
+
+    if (n_glyphs < 0 || glyph_w != pdc_fwidth || glyph_h != pdc_fheight)
+    {
+        PDC_flush_glyphs();
+        glyph_w = pdc_fwidth;
+        glyph_h = pdc_fheight;
+    }
+
+    bucket = _glyph_bucket(ch, rgb, font_style);
+
+    for (i = glyph_hash[bucket]; i != -1; i = glyphs[i].hash_next)
+        if (glyphs[i].ch == ch && glyphs[i].rgb == rgb &&
+            glyphs[i].style == font_style)
+            break;
+
+    if (i == -1)
+    {
+        i = _add_glyph(ch, rgb, bucket);
+
+        if (i == -1)
+            return NULL;
+    }
+    else if (i != lru_first)
+    {
+        _lru_unlink(i);
+        _lru_push(i);
+    }
+
+    _glyph_slot(i, slot);
+
+    return glyph_atlas[i / GLYPHS_PER_ATLAS];
+}
+
+#endif
+
 /* do the real updates on a delay */
 
 void PDC_update_rects(void)
@@ -48,11 +264,11 @@ static void _set_attr(chtype ch)
     attr_t sysattrs = SP->termattrs;
 
 #ifdef PDC_WIDE
-    TTF_SetFontStyle(pdc_ttffont,
+    font_style =
         ( ((ch & A_BOLD) && (sysattrs & A_BOLD)) ?
             TTF_STYLE_BOLD : 0) |
         ( ((ch & A_ITALIC) && (sysattrs & A_ITALIC)) ?
-            TTF_STYLE_ITALIC : 0) );
+            TTF_STYLE_ITALIC : 0);
 #endif
 
     ch &= (A_COLOR|A_BOLD|A_BLINK|A_REVERSE);
@@ -226,7 +442,7 @@ void PDC_gotoyx(int row, int col)
     chtype ch;
     int oldrow, oldcol;
 #ifdef PDC_WIDE
-    Uint16 chstr[2] = {0, 0};
+    SDL_Surface *atlas;
 #endif
 
     PDC_LOG(("PDC_gotoyx() - called: row %d col %d from row %d col %d\n",
@@ -267,21 +483,15 @@ void PDC_gotoyx(int row, int col)
         if (ch & A_ALTCHARSET && !(ch & 0xff80))
             ch = acs_map[ch & 0x7f];
 
-        chstr[0] = ch & A_CHARTEXT;
+        atlas = _get_glyph(ch & A_CHARTEXT, &src);
 
-        pdc_font = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
-                                             pdc_color[foregr]);
-        if (pdc_font)
+        if (atlas)
         {
-            int center = pdc_fwidth > pdc_font->w ?
-                        (pdc_fwidth - pdc_font->w) >> 1 : 0;
-            src.x = 0;
-            src.y = pdc_fheight - src.h;
-            dest.x += center;
-            SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-            dest.x -= center;
-            SDL_FreeSurface(pdc_font);
-            pdc_font = NULL;
+            SDL_Rect tmp = dest;
+
+            src.y += pdc_fheight - dest.h;
+            src.h = dest.h;
+            SDL_BlitSurface(atlas, &src, pdc_screen, &tmp);
         }
     }
 #else
@@ -307,9 +517,6 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
 {
     SDL_Rect src, dest, lastrect;
     int j;
-#ifdef PDC_WIDE
-    Uint16 chstr[2] = {0, 0};
-#endif
     attr_t sysattrs = SP->termattrs;
     int hcol = SP->line_color;
     bool blink = blinked_off && (attr & A_BLINK) && (sysattrs & A_BLINK);
@@ -317,10 +524,6 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
     if (rectcount == MAXRECT)
         PDC_update_rects();
 
-#ifdef PDC_WIDE
-    src.x = 0;
-    src.y = 0;
-#endif
     src.h = pdc_fheight;
     src.w = pdc_fwidth;
 
@@ -385,24 +588,13 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
 
         if (ch != ' ')
         {
-            if (chstr[0] != ch)
-            {
-                chstr[0] = ch;
-
-                if (pdc_font)
-                    SDL_FreeSurface(pdc_font);
-
-                pdc_font = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
-                                                     pdc_color[foregr]);
-            }
+            SDL_Surface *atlas = _get_glyph(ch, &src);
 
-            if (pdc_font)
+            if (atlas)
             {
-                int center = pdc_fwidth > pdc_font->w ?
-                    (pdc_fwidth - pdc_font->w) >> 1 : 0;
-                dest.x += center;
-                SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-                dest.x -= center;
+                SDL_Rect tmp = dest;
+
+                SDL_BlitSurface(atlas, &src, pdc_screen, &tmp);
             }
         }
 #else
@@ -430,14 +622,6 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
         dest.x += pdc_fwidth;
     }
 
-#ifdef PDC_WIDE
-    if (pdc_font)
-    {
-        SDL_FreeSurface(pdc_font);
-        pdc_font = NULL;
-    }
-#endif
-
     if (!blink && (attr & A_UNDERLINE))
     {
         dest.y += pdc_fheight - pdc_fthick;
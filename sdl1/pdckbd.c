@@ -86,6 +86,30 @@ bool PDC_check_key(void)
     return haveevent;
 }
 
+/* sleep until an event arrives, or ms milliseconds (ms < 0: forever).
+   SDL 1.2 has no timed wait, so timeouts are polled in 10 ms steps. */
+
+bool PDC_wait_for_input(int ms)
+{
+    Uint32 start = SDL_GetTicks();
+
+    PDC_update_rects();
+
+    if (ms < 0)
+        return SDL_WaitEvent(NULL) == 1;
+
+    for (;;)
+    {
+        Sint32 remaining = ms - (Sint32)(SDL_GetTicks() - start);
+
+        if (SDL_PollEvent(NULL))
+            return TRUE;
+        if (remaining <= 0)
+            return FALSE;
+        SDL_Delay(remaining > 10 ? 10 : remaining);
+    }
+}
+
 static int _process_key_event(void)
 {
     int i, key = 0;
@@ -272,22 +296,7 @@ static int _process_mouse_event(void)
         if (btn < 1 || btn > 3)
             return -1;
 
-        /* check for a click -- a press followed immediately by a release */
-
-        if (action == BUTTON_PRESSED && SP->mouse_wait)
-        {
-            SDL_Event rel;
-
-            napms(SP->mouse_wait);
-
-            if (SDL_PollEvent(&rel))
-            {
-                if (rel.type == SDL_MOUSEBUTTONUP && rel.button.button == btn)
-                    action = BUTTON_CLICKED;
-                else
-                    SDL_PushEvent(&rel);
-            }
-        }
+        /* clicks are made from the press and release in the core */
 
         btn--;
 
@@ -352,6 +361,13 @@ void PDC_flushinp(void)
     while (PDC_check_key());
 }
 
+/* SDL 1.2 has no file descriptor for an event loop to wait on */
+
+int PDC_get_input_fd(void)
+{
+    return -1;
+}
+
 bool PDC_has_mouse(void)
 {
     return TRUE;
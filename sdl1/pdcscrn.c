@@ -32,6 +32,7 @@ static void _clean(void)
 #ifdef PDC_WIDE
     if (pdc_ttffont)
     {
+        PDC_flush_glyphs();
         TTF_CloseFont(pdc_ttffont);
         TTF_Quit();
     }
@@ -36,3 +36,6 @@ PDCEX  void PDC_update_rects(void);
 PDCEX  void PDC_retile(void);
 
 extern void PDC_blink_text(void);
+#ifdef PDC_WIDE
+extern void PDC_flush_glyphs(void);
+#endif
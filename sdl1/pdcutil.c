@@ -22,6 +22,11 @@ void PDC_napms(int ms)
     SDL_Delay(ms);
 }
 
+long PDC_millisecs(void)
+{
+    return (long)SDL_GetTicks();
+}
+
 const char *PDC_sysname(void)
 {
     return "SDL";
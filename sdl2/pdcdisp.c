@@ -13,63 +13,615 @@
 
 # include "../common/acs_defs.h"
 
-#define MAXRECT 200     /* maximum number of rects to queue up before
-                           an update is forced; the number was chosen
-                           arbitrarily */
-
-static SDL_Rect uprect[MAXRECT];       /* table of rects to update */
 static chtype oldch = (chtype)(-1);    /* current attribute */
-static int rectcount = 0;              /* index into uprect */
 static int foregr = -2, backgr = -2; /* current foreground, background */
 static bool blinked_off = FALSE;
 
-/* do the real updates on a delay */
+/* Changed cells are noted in a grid of tiles, each one line high and
+   DAMAGE_TILE_COLS cells wide. At update time, each run of dirty tiles
+   in a line becomes a rect, merged with the one above it if they line
+   up; so there are never more than a few rects per line, and the area
+   updated is close to the area changed. */
+
+#define DAMAGE_TILE_COLS 8
+
+static unsigned char *damage = NULL;   /* one flag per tile */
+static int damage_lines = 0, damage_tiles = 0;
+static bool damaged = FALSE;           /* anything to update? */
+static bool damage_all = FALSE;        /* just update the whole window */
+static SDL_Rect *uprect = NULL;        /* rects to update */
+static int *open_rects = NULL;         /* work space for merging */
+
+/* Each run of cells with the same attributes (a "packet") is prepared
+   -- its colors worked out, and its glyphs found or rendered -- before
+   it's drawn. With worker threads (see PDC_start_workers()), prepared
+   packets are queued until the end of the update, then drawn in
+   horizontal bands, one per thread, each in its own part of pdc_screen;
+   otherwise, each one is drawn as soon as it's ready. */
+
+#define MAX_WORKERS 15
+#define MIN_PARALLEL_CELLS 256  /* below this, just draw them */
+#define MAX_VIEWS 20
+
+typedef struct
+{
+    chtype ch;              /* after blinking and ACS mapping */
+#ifdef PDC_WIDE
+    int glyph;              /* its slot in the glyph cache, or -1 */
+#endif
+} CELL;
 
-void PDC_update_rects(void)
+typedef struct
+{
+    int lineno, x, len;
+    attr_t attr;
+    int fg, bg, hcol;       /* colors, as worked out by _set_attr() */
+    bool blink;             /* blinked off? */
+#ifndef PDC_WIDE
+    SDL_Surface *sheet;     /* font, in the right colors */
+#endif
+    int cell;               /* index of its first cell in cells[] */
+} PACKET;
+
+static PACKET *packets = NULL;
+static CELL *cells = NULL;
+static int n_packets = 0, max_packets = 0, n_cells = 0, max_cells = 0;
+
+/* SDL keeps the parameters of a blit in its source surface, so two
+   threads can't blit from the same one at once. Instead, each worker
+   gets its own "views" of the font, glyph and background surfaces --
+   surfaces of its own, sharing their pixels -- for the duration. */
+
+typedef struct
+{
+    SDL_Surface *orig[MAX_VIEWS], *view[MAX_VIEWS];
+    int n;
+} VIEWS;
+
+static VIEWS views[MAX_WORKERS];
+static SDL_Thread *workers[MAX_WORKERS];
+static int n_workers = 0;               /* not counting the main thread */
+static SDL_mutex *pool_lock = NULL;
+static SDL_cond *work_ready = NULL, *work_done = NULL;
+static int generation = 0, busy = 0;    /* guarded by pool_lock */
+static int start_generation = 0;        /* generation when started */
+static bool pool_stop = FALSE;
+
+static void _flush_packets(void);
+
+static void _clear_damage(void)
+{
+    if (damage)
+        memset(damage, 0, damage_lines * damage_tiles);
+
+    damaged = damage_all = FALSE;
+}
+
+static void _note_damage(int lineno, int x, int len)
+{
+    int tiles = (SP->cols + DAMAGE_TILE_COLS - 1) / DAMAGE_TILE_COLS;
+    int first, last;
+
+    if (damage_lines != SP->lines || damage_tiles != tiles)
+    {
+        /* a new screen size; the old damage is moot */
+
+        int runs = (tiles + 1) / 2;    /* at most, per line */
+
+        free(damage);
+        free(uprect);
+        free(open_rects);
+
+        damage = calloc(SP->lines * tiles, 1);
+        uprect = malloc(SP->lines * runs * sizeof(SDL_Rect));
+        open_rects = malloc(2 * tiles * sizeof(int));
+
+        damage_lines = SP->lines;
+        damage_tiles = tiles;
+        damaged = damage_all = TRUE;
+
+        if (!damage || !uprect || !open_rects)
+            damage_lines = damage_tiles = 0;
+    }
+
+    damaged = TRUE;
+
+    if (!damage_lines || damage_all)
+        return;
+
+    first = x / DAMAGE_TILE_COLS;
+    last = (x + len - 1) / DAMAGE_TILE_COLS;
+
+    if (last >= tiles)
+        last = tiles - 1;
+
+    if (lineno >= 0 && lineno < damage_lines && first <= last)
+        memset(damage + lineno * tiles + first, 1, last - first + 1);
+}
+
+#ifdef PDC_WIDE
+
+/* Rendered glyphs are cached, so that drawing a character again in the
+   same style and color is a single blit, rather than a trip through
+   SDL_ttf. Each glyph is kept, centered in a cell-sized slot, in one of
+   a few "atlas" surfaces; once they're full, the least recently used
+   glyph makes way for the new one. */
+
+#define GLYPH_ATLAS_COLS 32     /* slots across an atlas */
+#define GLYPH_ATLAS_ROWS 16     /* slots down an atlas */
+#define GLYPH_ATLASES    4
+#define GLYPHS_PER_ATLAS (GLYPH_ATLAS_COLS * GLYPH_ATLAS_ROWS)
+#define GLYPH_SLOTS      (GLYPHS_PER_ATLAS * GLYPH_ATLASES)
+#define GLYPH_HASH_SIZE  2048   /* must be a power of two */
+
+typedef struct
+{
+    Uint32 ch;              /* the character */
+    Uint32 rgb;             /* and its foreground color */
+    int style;              /* TTF_STYLE_* */
+    int hash_next;          /* next slot in the same bucket, or -1 */
+    int lru_prev, lru_next; /* slots used more/less recently, or -1 */
+} GLYPH;
+
+static GLYPH glyphs[GLYPH_SLOTS];
+static int glyph_hash[GLYPH_HASH_SIZE];
+static SDL_Surface *glyph_atlas[GLYPH_ATLASES];
+static int n_glyphs = -1;               /* -1 until initialized */
+static int lru_first = -1, lru_last = -1;
+static int glyph_w, glyph_h;            /* size of a slot */
+static int font_style = 0;              /* as set by _set_attr() */
+
+/* discard all cached glyphs, as when the font is changed or closed */
+
+void PDC_flush_glyphs(void)
 {
     int i;
 
-    if (rectcount)
+    for (i = 0; i < GLYPH_ATLASES; i++)
     {
-        /* if the maximum number of rects has been reached, we're
-           probably better off doing a full screen update */
+        SDL_FreeSurface(glyph_atlas[i]);
+        glyph_atlas[i] = NULL;
+    }
+
+    for (i = 0; i < GLYPH_HASH_SIZE; i++)
+        glyph_hash[i] = -1;
+
+    n_glyphs = 0;
+    lru_first = lru_last = -1;
+}
+
+static unsigned _glyph_bucket(Uint32 ch, Uint32 rgb, int style)
+{
+    return ((ch * 31 + rgb) * 2654435761u + (unsigned)style)
+           >> 8 & (GLYPH_HASH_SIZE - 1);
+}
+
+static void _lru_unlink(int i)
+{
+    if (glyphs[i].lru_prev == -1)
+        lru_first = glyphs[i].lru_next;
+    else
+        glyphs[glyphs[i].lru_prev].lru_next = glyphs[i].lru_next;
+
+    if (glyphs[i].lru_next == -1)
+        lru_last = glyphs[i].lru_prev;
+    else
+        glyphs[glyphs[i].lru_next].lru_prev = glyphs[i].lru_prev;
+}
+
+static void _lru_push(int i)
+{
+    glyphs[i].lru_prev = -1;
+    glyphs[i].lru_next = lru_first;
+
+    if (lru_first == -1)
+        lru_last = i;
+    else
+        glyphs[lru_first].lru_prev = i;
+
+    lru_first = i;
+}
+
+/* take the least recently used slot out of the cache, and return it */
+
+static int _evict_glyph(void)
+{
+    int i = lru_last;
+    int *link = glyph_hash + _glyph_bucket(glyphs[i].ch, glyphs[i].rgb,
+                                           glyphs[i].style);
+
+    while (*link != i)
+        link = &glyphs[*link].hash_next;
+
+    *link = glyphs[i].hash_next;
+    _lru_unlink(i);
+
+    return i;
+}
+
+static void _glyph_slot(int i, SDL_Rect *slot)
+{
+    slot->x = i % GLYPH_ATLAS_COLS * glyph_w;
+    slot->y = i % GLYPHS_PER_ATLAS / GLYPH_ATLAS_COLS * glyph_h;
+    slot->w = glyph_w;
+    slot->h = glyph_h;
+}
+
+/* render a glyph into a free (or freed) slot; returns the slot, or -1 */
+
+static int _add_glyph(Uint32 ch, Uint32 rgb, unsigned bucket)
+{
+    SDL_Surface *rendered;
+    SDL_Rect src, dest;
+    Uint16 chstr[2] = {0, 0};
+    int i, atlas;
+
+    if (TTF_GetFontStyle(pdc_ttffont) != font_style)
+        TTF_SetFontStyle(pdc_ttffont, font_style);
+
+    chstr[0] = (Uint16)ch;
+    rendered = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
+                                         pdc_color[foregr]);
+    if (!rendered)
+        return -1;
+
+    /* queued packets may be using the glyph that's about to go */
+
+    if (n_glyphs == GLYPH_SLOTS)
+        _flush_packets();
+
+    i = (n_glyphs < GLYPH_SLOTS) ? n_glyphs : _evict_glyph();
+    atlas = i / GLYPHS_PER_ATLAS;
+
+    if (!glyph_atlas[atlas])
+    {
+        glyph_atlas[atlas] = SDL_CreateRGBSurface(0,
+            GLYPH_ATLAS_COLS * glyph_w, GLYPH_ATLAS_ROWS * glyph_h, 32,
+            0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+
+        if (!glyph_atlas[atlas])
+        {
+            SDL_FreeSurface(rendered);
+            return -1;
+        }
+    }
+
+    if (i == n_glyphs)
+        n_glyphs++;
+
+    /* copy the glyph, alpha and all, centered in its slot */
+
+    _glyph_slot(i, &dest);
+    SDL_FillRect(glyph_atlas[atlas], &dest, 0);
+
+    src.x = 0;
+    src.y = 0;
+    src.w = min(rendered->w, glyph_w);
+    src.h = min(rendered->h, glyph_h);
+
+    if (glyph_w > rendered->w)
+        dest.x += (glyph_w - rendered->w) >> 1;
+
+    SDL_SetSurfaceBlendMode(rendered, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(rendered, &src, glyph_atlas[atlas], &dest);
+    SDL_FreeSurface(rendered);
+
+    glyphs[i].ch = ch;
+    glyphs[i].rgb = rgb;
+    glyphs[i].style = font_style;
+    glyphs[i].hash_next = glyph_hash[bucket];
+    glyph_hash[bucket] = i;
+    _lru_push(i);
+
+    return i;
+}
+
+/* find (or render) the glyph for ch in the current style and foreground
+   color; returns its slot, or -1 */
+
+static int _get_glyph(chtype ch)
+{
+    SDL_Color fg = pdc_color[foregr];
+    Uint32 rgb = ((Uint32)fg.r << 16) | ((Uint32)fg.g << 8) | fg.b;
+    unsigned bucket;
+    int i;
+
+    if (n_glyphs < 0 || glyph_w != pdc_fwidth || glyph_h != pdc_fheight)
+    {
+        PDC_flush_glyphs();
+        glyph_w = pdc_fwidth;
+        glyph_h = pdc_fheight;
+    }
+
+    bucket = _glyph_bucket(ch, rgb, font_style);
+
+    for (i = glyph_hash[bucket]; i != -1; i = glyphs[i].hash_next)
+        if (glyphs[i].ch == ch && glyphs[i].rgb == rgb &&
+            glyphs[i].style == font_style)
+            break;
+
+    if (i == -1)
+        i = _add_glyph(ch, rgb, bucket);
+    else if (i != lru_first)
+    {
+        _lru_unlink(i);
+        _lru_push(i);
+    }
+
+    return i;
+}
 
-        if (rectcount == MAXRECT)
-            SDL_UpdateWindowSurface(pdc_window);
+#else
+
+/* The 8-bit font is colored through its palette; but changing that
+   makes SDL rebuild its blit mapping, and paletted blits are slow in any
+   case. So for each foreground/background pair in use, a copy of the
+   font is kept, already colored and converted to the screen's format;
+   when there are too many, the least recently used copy goes. */
+
+#define MAX_SHEETS 16
+#define NO_BACKGROUND 0xffffffff   /* for a transparent background */
+
+static struct
+{
+    SDL_Surface *sheet;
+    Uint32 fg, bg;                 /* RGB values it was colored with */
+    unsigned long last_used;
+} sheets[MAX_SHEETS];
+
+static SDL_Surface *font_sheet = NULL;  /* current colors, or NULL to
+                                           use pdc_font as is */
+static SDL_Surface *sheet_font = NULL;  /* pdc_font the sheets came from */
+static Uint32 sheet_format = 0;         /* and the screen's format then */
+static unsigned long sheet_clock = 0;
+
+/* discard all colored copies of the font */
+
+void PDC_flush_sheets(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_SHEETS; i++)
+    {
+        SDL_FreeSurface(sheets[i].sheet);
+        sheets[i].sheet = NULL;
+    }
+
+    font_sheet = NULL;
+}
+
+static Uint32 _rgb(int color)
+{
+    return ((Uint32)pdc_color[color].r << 16) |
+           ((Uint32)pdc_color[color].g << 8) | pdc_color[color].b;
+}
+
+static void _set_sheet(int fg, int bg)
+{
+    Uint32 fgrgb = _rgb(fg);
+    Uint32 bgrgb = (bg == -1) ? NO_BACKGROUND : _rgb(bg);
+    int i, victim = 0;
+
+    if (sheet_font != pdc_font || sheet_format != pdc_screen->format->format)
+    {
+        PDC_flush_sheets();
+        sheet_font = pdc_font;
+        sheet_format = pdc_screen->format->format;
+    }
+
+    for (i = 0; i < MAX_SHEETS; i++)
+    {
+        if (!sheets[i].sheet)
+        {
+            if (sheets[victim].sheet)
+                victim = i;
+        }
+        else if (sheets[i].fg == fgrgb && sheets[i].bg == bgrgb)
+        {
+            sheets[i].last_used = ++sheet_clock;
+            font_sheet = sheets[i].sheet;
+            return;
+        }
+        else if (sheets[victim].sheet &&
+                 sheets[i].last_used < sheets[victim].last_used)
+            victim = i;
+    }
+
+    /* not found; color the font, and make a copy from it -- but first,
+       draw anything queued that might use either of them */
+
+    _flush_packets();
+
+    SDL_SetPaletteColors(pdc_font->format->palette,
+                         pdc_color + fg, pdc_flastc, 1);
+
+    if (bg == -1)
+        SDL_SetColorKey(pdc_font, SDL_TRUE, 0);
+    else
+    {
+        SDL_SetColorKey(pdc_font, SDL_FALSE, 0);
+        SDL_SetPaletteColors(pdc_font->format->palette,
+                             pdc_color + bg, 0, 1);
+    }
+
+    SDL_FreeSurface(sheets[victim].sheet);
+    sheets[victim].sheet = SDL_ConvertSurface(pdc_font, pdc_screen->format,
+                                              0);
+    sheets[victim].fg = fgrgb;
+    sheets[victim].bg = bgrgb;
+    sheets[victim].last_used = ++sheet_clock;
+
+    /* if that failed, we can still use the recolored font directly */
+
+    font_sheet = sheets[victim].sheet;
+}
+
+#endif
+
+/* With PDC_RENDERER set, the window is drawn by an SDL_Renderer, and
+   pdc_screen is a surface of our own, copied to a streaming texture of
+   the same size; this sets up both, to match the window's size. */
+
+void PDC_get_screen(void)
+{
+    int w, h;
+
+    if (!pdc_renderer)
+    {
+        pdc_screen = SDL_GetWindowSurface(pdc_window);
+        return;
+    }
+
+    SDL_GetWindowSize(pdc_window, &w, &h);
+
+    if (pdc_screen && pdc_texture && pdc_screen->w == w && pdc_screen->h == h)
+        return;
+
+    SDL_DestroyTexture(pdc_texture);
+    SDL_FreeSurface(pdc_screen);
+
+    pdc_texture = SDL_CreateTexture(pdc_renderer, SDL_PIXELFORMAT_RGB888,
+                                    SDL_TEXTUREACCESS_STREAMING, w, h);
+    pdc_screen = SDL_CreateRGBSurface(0, w, h, 32,
+                                      0x00ff0000, 0x0000ff00, 0x000000ff, 0);
+
+    if (!pdc_texture || !pdc_screen)
+    {
+        /* fall back to the window surface */
+
+        SDL_DestroyTexture(pdc_texture);
+        SDL_FreeSurface(pdc_screen);
+        SDL_DestroyRenderer(pdc_renderer);
+        pdc_texture = NULL;
+        pdc_renderer = NULL;
+        pdc_screen = SDL_GetWindowSurface(pdc_window);
+    }
+}
+
+/* copy the given rects (or with rects == NULL, all) of pdc_screen to the
+   window */
+
+static void _update_window(const SDL_Rect *rects, int n)
+{
+    if (pdc_renderer)
+    {
+        if (!rects)
+            SDL_UpdateTexture(pdc_texture, NULL, pdc_screen->pixels,
+                              pdc_screen->pitch);
         else
         {
-            int w = pdc_screen->w;
-            int h = pdc_screen->h;
+            int i;
+
+            for (i = 0; i < n; i++)
+                SDL_UpdateTexture(pdc_texture, rects + i,
+                    (Uint8 *)pdc_screen->pixels + rects[i].y *
+                    pdc_screen->pitch + rects[i].x * 4, pdc_screen->pitch);
+        }
+
+        SDL_RenderCopy(pdc_renderer, pdc_texture, NULL, NULL);
+        SDL_RenderPresent(pdc_renderer);
+    }
+    else if (!rects)
+        SDL_UpdateWindowSurface(pdc_window);
+    else
+        SDL_UpdateWindowSurfaceRects(pdc_window, rects, n);
+}
+
+/* do the real updates on a delay */
+
+void PDC_update_rects(void)
+{
+    SDL_Rect *rect;
+    int *above, *here, *swap, n_above = 0, n = 0, y, t, i;
+    int w = pdc_screen->w;
+    int h = pdc_screen->h;
+
+    _flush_packets();
+
+    if (!damaged)
+        return;
+
+    if (damage_all)
+    {
+        _update_window(NULL, 0);
+        _clear_damage();
+        return;
+    }
+
+    /* turn each run of dirty tiles into a rect; if there's a rect from
+       the line above that lines up with it, extend that one instead */
+
+    above = open_rects;
+    here = open_rects + damage_tiles;
+
+    for (y = 0; y < damage_lines; y++)
+    {
+        unsigned char *tile = damage + y * damage_tiles;
+        int n_here = 0, a = 0;
+
+        for (t = 0; t < damage_tiles; t++)
+        {
+            SDL_Rect r;
+            int start = t;
 
-            for (i = 0; i < rectcount; i++)
+            if (!tile[t])
+                continue;
+
+            while (t < damage_tiles && tile[t])
+                tile[t++] = 0;
+
+            r.x = pdc_xoffset + start * DAMAGE_TILE_COLS * pdc_fwidth;
+            r.w = pdc_xoffset + min(t * DAMAGE_TILE_COLS, SP->cols) *
+                  pdc_fwidth - r.x;
+            r.y = pdc_yoffset + y * pdc_fheight;
+            r.h = pdc_fheight;
+
+            while (a < n_above && uprect[above[a]].x < r.x)
+                a++;
+
+            if (a < n_above && uprect[above[a]].x == r.x &&
+                uprect[above[a]].w == r.w)
             {
-                if (uprect[i].x > w ||
-                    uprect[i].y > h ||
-                    !uprect[i].w || !uprect[i].h)
-                {
-                    if (i + 1 < rectcount)
-                    {
-                        memmove(uprect + i, uprect + i + 1,
-                                (rectcount - i + 1) * sizeof(*uprect));
-                        --i;
-                    }
-                    rectcount--;
-                    continue;
-                }
-
-                if (uprect[i].x + uprect[i].w > w)
-                    uprect[i].w = min(w, w - uprect[i].x);
-
-                if (uprect[i].y + uprect[i].h > h)
-                    uprect[i].h = min(h, h - uprect[i].y);
+                i = above[a];
+                uprect[i].h += r.h;
+            }
+            else
+            {
+                i = n++;
+                uprect[i] = r;
             }
 
-            if (rectcount > 0)
-                SDL_UpdateWindowSurfaceRects(pdc_window, uprect, rectcount);
+            here[n_here++] = i;
         }
 
-        rectcount = 0;
+        n_above = n_here;
+        swap = above;
+        above = here;
+        here = swap;
     }
+
+    damaged = FALSE;
+
+    /* clip them to the screen */
+
+    for (i = t = 0; i < n; i++)
+    {
+        rect = uprect + i;
+
+        if (rect->x >= w || rect->y >= h)
+            continue;
+
+        if (rect->x + rect->w > w)
+            rect->w = w - rect->x;
+
+        if (rect->y + rect->h > h)
+            rect->h = h - rect->y;
+
+        uprect[t++] = *rect;
+    }
+
+    if (t)
+        _update_window(uprect, t);
 }
 
 /* set the font colors to match the chtype's attribute */
@@ -79,11 +631,11 @@ static void _set_attr(chtype ch)
     attr_t sysattrs = SP->termattrs;
 
 #ifdef PDC_WIDE
-    TTF_SetFontStyle(pdc_ttffont,
+    font_style =
         ( ((ch & A_BOLD) && (sysattrs & A_BOLD)) ?
             TTF_STYLE_BOLD : 0) |
         ( ((ch & A_ITALIC) && (sysattrs & A_ITALIC)) ?
-            TTF_STYLE_ITALIC : 0) );
+            TTF_STYLE_ITALIC : 0);
 #endif
 
     ch &= (A_COLOR|A_BOLD|A_BLINK|A_REVERSE);
@@ -109,31 +661,11 @@ static void _set_attr(chtype ch)
             newbg = tmp;
         }
 
-        if (newfg != foregr)
-        {
 #ifndef PDC_WIDE
-            SDL_SetPaletteColors(pdc_font->format->palette,
-                                 pdc_color + newfg, pdc_flastc, 1);
+        _set_sheet(newfg, newbg);
 #endif
-            foregr = newfg;
-        }
-
-        if (newbg != backgr)
-        {
-#ifndef PDC_WIDE
-            if (newbg == -1)
-                SDL_SetColorKey(pdc_font, SDL_TRUE, 0);
-            else
-            {
-                if (backgr == -1)
-                    SDL_SetColorKey(pdc_font, SDL_FALSE, 0);
-
-                SDL_SetPaletteColors(pdc_font->format->palette,
-                                     pdc_color + newbg, 0, 1);
-            }
-#endif
-            backgr = newbg;
-        }
+        foregr = newfg;
+        backgr = newbg;
 
         oldch = ch;
     }
@@ -143,9 +675,9 @@ static void _set_attr(chtype ch)
 
 /* Draw some of the ACS_* "graphics" */
 
-bool _grprint(chtype ch, SDL_Rect dest)
+bool _grprint(chtype ch, SDL_Rect dest, int fg)
 {
-    Uint32 col = pdc_mapped[foregr];
+    Uint32 col = pdc_mapped[fg];
     int hmid = (pdc_fheight - pdc_fthick) >> 1;
     int wmid = (pdc_fwidth - pdc_fthick) >> 1;
 
@@ -257,7 +789,7 @@ void PDC_gotoyx(int row, int col)
     chtype ch;
     int oldrow, oldcol;
 #ifdef PDC_WIDE
-    Uint16 chstr[2] = {0, 0};
+    int glyph;
 #endif
 
     PDC_LOG(("PDC_gotoyx() - called: row %d col %d from row %d col %d\n",
@@ -269,6 +801,7 @@ void PDC_gotoyx(int row, int col)
     /* clear the old cursor */
 
     PDC_transform_line(oldrow, oldcol, 1, curscr->_y[oldrow] + oldcol);
+    _flush_packets();
 
     if (!SP->visibility)
         return;
@@ -293,26 +826,22 @@ void PDC_gotoyx(int row, int col)
     SDL_FillRect(pdc_screen, &dest, pdc_mapped[backgr]);
 
     if (!(SP->visibility == 2 && (ch & A_ALTCHARSET && !(ch & 0xff80)) &&
-        _grprint(ch & (0x7f | A_ALTCHARSET), dest)))
+        _grprint(ch & (0x7f | A_ALTCHARSET), dest, foregr)))
     {
         if (ch & A_ALTCHARSET && !(ch & 0xff80))
             ch = acs_map[ch & 0x7f];
 
-        chstr[0] = ch & A_CHARTEXT;
+        glyph = _get_glyph(ch & A_CHARTEXT);
 
-        pdc_font = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
-                                             pdc_color[foregr]);
-        if (pdc_font)
+        if (glyph != -1)
         {
-            int center = pdc_fwidth > pdc_font->w ?
-                        (pdc_fwidth - pdc_font->w) >> 1 : 0;
-            src.x = 0;
-            src.y = pdc_fheight - src.h;
-            dest.x += center;
-            SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-            dest.x -= center;
-            SDL_FreeSurface(pdc_font);
-            pdc_font = NULL;
+            SDL_Rect tmp = dest;
+
+            _glyph_slot(glyph, &src);
+            src.y += pdc_fheight - dest.h;
+            src.h = dest.h;
+            SDL_BlitSurface(glyph_atlas[glyph / GLYPHS_PER_ATLAS], &src,
+                            pdc_screen, &tmp);
         }
     }
 #else
@@ -322,162 +851,446 @@ void PDC_gotoyx(int row, int col)
     src.x = (ch & 0xff) % 32 * pdc_fwidth;
     src.y = (ch & 0xff) / 32 * pdc_fheight + (pdc_fheight - src.h);
 
-    SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
+    SDL_BlitSurface(font_sheet ? font_sheet : pdc_font, &src,
+                    pdc_screen, &dest);
 #endif
 
     if (oldrow != row || oldcol != col)
-    {
-        if (rectcount == MAXRECT)
-            PDC_update_rects();
+        _note_damage(row, col, 1);
+}
 
-        uprect[rectcount++] = dest;
-    }
+/* the surface to blit from in place of s -- a worker's view of it, or
+   for the main thread, s itself */
+
+static SDL_Surface *_source(const VIEWS *v, SDL_Surface *s)
+{
+    int i;
+
+    if (v)
+        for (i = 0; i < v->n; i++)
+            if (v->orig[i] == s)
+                return v->view[i];
+
+    return s;
 }
 
-void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
+/* draw a prepared packet */
+
+static void _draw_packet(const PACKET *p, const VIEWS *v)
 {
-    SDL_Rect src, dest, lastrect;
+    SDL_Rect src, dest;
+    const CELL *cell = cells + p->cell;
     int j;
+
+    src.h = pdc_fheight;
+    src.w = pdc_fwidth;
+
+    dest.y = pdc_fheight * p->lineno + pdc_yoffset;
+    dest.x = pdc_fwidth * p->x + pdc_xoffset;
+    dest.h = pdc_fheight;
+    dest.w = pdc_fwidth * p->len;
+
+    if (p->bg == -1)
+        SDL_BlitSurface(_source(v, pdc_tileback), &dest, pdc_screen, &dest);
 #ifdef PDC_WIDE
-    Uint16 chstr[2] = {0, 0};
+    else
+        SDL_FillRect(pdc_screen, &dest, pdc_mapped[p->bg]);
 #endif
-    attr_t sysattrs = SP->termattrs;
-    short hcol = SP->line_color;
-    bool blink = blinked_off && (attr & A_BLINK) && (sysattrs & A_BLINK);
 
-    if (rectcount == MAXRECT)
-        PDC_update_rects();
+    for (j = 0; j < p->len; j++)
+    {
+        chtype ch = cell[j].ch;
+
+        dest.w = pdc_fwidth;
 
 #ifdef PDC_WIDE
-    src.x = 0;
-    src.y = 0;
+        if (!(ch & A_ALTCHARSET && _grprint(ch, dest, p->fg)) &&
+            cell[j].glyph != -1)
+        {
+            SDL_Rect tmp = dest;
+
+            _glyph_slot(cell[j].glyph, &src);
+            SDL_BlitSurface(_source(v,
+                                glyph_atlas[cell[j].glyph / GLYPHS_PER_ATLAS]),
+                            &src, pdc_screen, &tmp);
+        }
+#else
+        src.x = (ch & 0xff) % 32 * pdc_fwidth;
+        src.y = (ch & 0xff) / 32 * pdc_fheight;
+
+        SDL_BlitSurface(_source(v, p->sheet), &src, pdc_screen, &dest);
 #endif
-    src.h = pdc_fheight;
-    src.w = pdc_fwidth;
 
-    dest.y = pdc_fheight * lineno + pdc_yoffset;
-    dest.x = pdc_fwidth * x + pdc_xoffset;
-    dest.h = pdc_fheight;
-    dest.w = pdc_fwidth * len;
+        if (!p->blink && (p->attr & (A_LEFT | A_RIGHT)))
+        {
+            dest.w = pdc_fthick;
+
+            if (p->attr & A_LEFT)
+                SDL_FillRect(pdc_screen, &dest, pdc_mapped[p->hcol]);
+
+            if (p->attr & A_RIGHT)
+            {
+                dest.x += pdc_fwidth - pdc_fthick;
+                SDL_FillRect(pdc_screen, &dest, pdc_mapped[p->hcol]);
+                dest.x -= pdc_fwidth - pdc_fthick;
+            }
+        }
+
+        dest.x += pdc_fwidth;
+    }
+
+    if (!p->blink && (p->attr & A_UNDERLINE))
+    {
+        dest.y += pdc_fheight - pdc_fthick;
+        dest.x = pdc_fwidth * p->x + pdc_xoffset;
+        dest.h = pdc_fthick;
+        dest.w = pdc_fwidth * p->len;
 
-    /* if the previous rect was just above this one, with the same width
-       and horizontal position, then merge the new one with it instead
-       of adding a new entry */
+        SDL_FillRect(pdc_screen, &dest, pdc_mapped[p->hcol]);
+    }
+}
 
-    if (rectcount)
-        lastrect = uprect[rectcount - 1];
+/* draw the queued packets whose lines fall in the given band */
 
-    if (rectcount && lastrect.x == dest.x && lastrect.w == dest.w)
+static void _draw_band(int band)
+{
+    int bands = n_workers + 1;
+    int first = band * SP->lines / bands;
+    int last = (band + 1) * SP->lines / bands;
+    const VIEWS *v = band ? views + band - 1 : NULL;
+    int i;
+
+    for (i = 0; i < n_packets; i++)
+        if (packets[i].lineno >= first && packets[i].lineno < last)
+            _draw_packet(packets + i, v);
+}
+
+static void _free_views(void)
+{
+    int i, j;
+
+    for (i = 0; i < n_workers; i++)
     {
-        if (lastrect.y + lastrect.h == dest.y)
-            uprect[rectcount - 1].h = lastrect.h + pdc_fheight;
-        else
-            if (lastrect.y != dest.y)
-                uprect[rectcount++] = dest;
+        for (j = 0; j < views[i].n; j++)
+            SDL_FreeSurface(views[i].view[j]);
+
+        views[i].n = 0;
     }
-    else
-        uprect[rectcount++] = dest;
+}
 
-    _set_attr(attr);
+static bool _add_view(VIEWS *v, SDL_Surface *s)
+{
+    SDL_Surface *view;
+    SDL_BlendMode mode;
+    Uint32 key;
+
+    if (!s)
+        return TRUE;
+
+    if (SDL_MUSTLOCK(s) || v->n == MAX_VIEWS)
+        return FALSE;
 
-    if (backgr == -1)
-        SDL_BlitSurface(pdc_tileback, &dest, pdc_screen, &dest);
+    view = SDL_CreateRGBSurfaceFrom(s->pixels, s->w, s->h,
+        s->format->BitsPerPixel, s->pitch, s->format->Rmask,
+        s->format->Gmask, s->format->Bmask, s->format->Amask);
+
+    if (!view)
+        return FALSE;
+
+    if (s->format->palette)
+        SDL_SetSurfacePalette(view, s->format->palette);
+
+    if (!SDL_GetColorKey(s, &key))
+        SDL_SetColorKey(view, SDL_TRUE, key);
+
+    SDL_GetSurfaceBlendMode(s, &mode);
+    SDL_SetSurfaceBlendMode(view, mode);
+
+    v->orig[v->n] = s;
+    v->view[v->n++] = view;
+
+    return TRUE;
+}
+
+/* give each worker its views of everything it might blit from */
+
+static bool _make_views(void)
+{
+    int i, j;
+
+    for (i = 0; i < n_workers; i++)
+    {
+        bool ok = _add_view(views + i, pdc_tileback);
 #ifdef PDC_WIDE
-    else
-        SDL_FillRect(pdc_screen, &dest, pdc_mapped[backgr]);
+        for (j = 0; ok && j < GLYPH_ATLASES; j++)
+            ok = _add_view(views + i, glyph_atlas[j]);
+#else
+        ok = ok && _add_view(views + i, pdc_font);
+
+        for (j = 0; ok && j < MAX_SHEETS; j++)
+            ok = _add_view(views + i, sheets[j].sheet);
 #endif
+        if (!ok)
+        {
+            _free_views();
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static int _worker(void *data)
+{
+    int band = (int)(size_t)data;
+    int done;
+
+    /* not the current generation: work may have been handed out before
+       this thread got to run */
+
+    SDL_LockMutex(pool_lock);
+    done = start_generation;
+
+    for (;;)
+    {
+        while (generation == done && !pool_stop)
+            SDL_CondWait(work_ready, pool_lock);
 
-    if (hcol == -1)
-        hcol = foregr;
+        if (pool_stop)
+            break;
+
+        done = generation;
+        SDL_UnlockMutex(pool_lock);
+
+        _draw_band(band);
+
+        SDL_LockMutex(pool_lock);
+        if (!--busy)
+            SDL_CondSignal(work_done);
+    }
+
+    SDL_UnlockMutex(pool_lock);
+
+    return 0;
+}
+
+/* draw everything queued; split across the workers, if there are any,
+   and it's worth it */
+
+static void _flush_packets(void)
+{
+    int i;
+
+    if (!n_packets)
+        return;
+
+    if (n_workers && n_cells >= MIN_PARALLEL_CELLS &&
+        !SDL_MUSTLOCK(pdc_screen) && _make_views())
+    {
+        SDL_LockMutex(pool_lock);
+        generation++;
+        busy = n_workers;
+        SDL_CondBroadcast(work_ready);
+        SDL_UnlockMutex(pool_lock);
+
+        _draw_band(0);
+
+        SDL_LockMutex(pool_lock);
+        while (busy)
+            SDL_CondWait(work_done, pool_lock);
+        SDL_UnlockMutex(pool_lock);
+
+        _free_views();
+    }
+    else
+        for (i = 0; i < n_packets; i++)
+            _draw_packet(packets + i, NULL);
+
+    n_packets = 0;
+    n_cells = 0;
+}
+
+/* make room in the queue for a packet of len cells */
+
+static bool _make_room(int len)
+{
+    if (n_packets == max_packets)
+    {
+        int new_max = max_packets ? max_packets * 2 : SP->lines * 4;
+        PACKET *new_packets = realloc(packets, new_max * sizeof(PACKET));
+
+        if (!new_packets)
+        {
+            _flush_packets();
+            return !!max_packets;
+        }
+
+        packets = new_packets;
+        max_packets = new_max;
+    }
+
+    if (n_cells + len > max_cells)
+    {
+        int new_max = max(max_cells * 2, n_cells + len);
+        CELL *new_cells = realloc(cells, new_max * sizeof(CELL));
+
+        if (!new_cells)
+        {
+            _flush_packets();
+            return len <= max_cells;
+        }
+
+        cells = new_cells;
+        max_cells = new_max;
+    }
+
+    return TRUE;
+}
+
+/* prepare a run of cells with the same attributes, and queue it (or
+   with no workers, just draw it) */
+
+void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
+{
+    PACKET *p;
+    CELL *cell;
+    attr_t sysattrs = SP->termattrs;
+    int j, start;
+
+    _note_damage(lineno, x, len);
+
+    _set_attr(attr);
+
+    if (!_make_room(len))
+        return;
+
+    start = n_cells;
+    cell = cells + start;
 
     for (j = 0; j < len; j++)
     {
         chtype ch = srcp[j];
 
-        if (blink)
+        if (blinked_off && (attr & A_BLINK) && (sysattrs & A_BLINK))
             ch = ' ';
 
-        dest.w = pdc_fwidth;
+#ifdef PDC_WIDE
+        cell[j].glyph = -1;
 
         if (ch & A_ALTCHARSET && !(ch & 0xff80))
         {
-#ifdef PDC_WIDE
-            if (_grprint(ch & (0x7f | A_ALTCHARSET), dest))
-            {
-                dest.x += pdc_fwidth;
-                continue;
-            }
-#endif
+            /* keep the ACS code for _grprint(), but have a glyph ready
+               in case it doesn't draw that one */
+
+            cell[j].ch = ch & (0x7f | A_ALTCHARSET);
             ch = acs_map[ch & 0x7f];
         }
+        else
+            cell[j].ch = ch & A_CHARTEXT;
 
-#ifdef PDC_WIDE
         ch &= A_CHARTEXT;
 
         if (ch != ' ')
-        {
-            if (chstr[0] != ch)
-            {
-                chstr[0] = ch;
+            cell[j].glyph = _get_glyph(ch);
+#else
+        if (ch & A_ALTCHARSET && !(ch & 0xff80))
+            ch = acs_map[ch & 0x7f];
 
-                if (pdc_font)
-                    SDL_FreeSurface(pdc_font);
+        cell[j].ch = ch;
+#endif
+    }
 
-                pdc_font = TTF_RenderUNICODE_Blended(pdc_ttffont, chstr,
-                                                     pdc_color[foregr]);
-            }
+    /* if making room for new glyphs meant drawing what was queued, the
+       cells just prepared go to the (now empty) front of the queue */
+
+    if (n_cells != start)
+        memmove(cells + n_cells, cell, len * sizeof(CELL));
+
+    p = packets + n_packets++;
+    p->lineno = lineno;
+    p->x = x;
+    p->len = len;
+    p->attr = attr;
+    p->fg = foregr;
+    p->bg = backgr;
+    p->hcol = (SP->line_color == -1) ? foregr : SP->line_color;
+    p->blink = blinked_off && (attr & A_BLINK) && (sysattrs & A_BLINK);
+#ifndef PDC_WIDE
+    p->sheet = font_sheet ? font_sheet : pdc_font;
+#endif
+    p->cell = n_cells;
+    n_cells += len;
 
-            if (pdc_font)
-            {
-                int center = pdc_fwidth > pdc_font->w ?
-                    (pdc_fwidth - pdc_font->w) >> 1 : 0;
-                dest.x += center;
-                SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-                dest.x -= center;
-            }
-        }
-#else
-        src.x = (ch & 0xff) % 32 * pdc_fwidth;
-        src.y = (ch & 0xff) / 32 * pdc_fheight;
+    if (!n_workers)
+        _flush_packets();
+}
 
-        SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-#endif
+/* With PDC_RENDER_THREADS set to a number above 1, that many threads
+   (including the main one) share the drawing. */
 
-        if (!blink && (attr & (A_LEFT | A_RIGHT)))
-        {
-            dest.w = pdc_fthick;
+void PDC_start_workers(void)
+{
+    const char *env = getenv("PDC_RENDER_THREADS");
+    int n = env ? atoi(env) - 1 : 0;
 
-            if (attr & A_LEFT)
-                SDL_FillRect(pdc_screen, &dest, pdc_mapped[hcol]);
+    if (n_workers || n < 1)
+        return;
 
-            if (attr & A_RIGHT)
-            {
-                dest.x += pdc_fwidth - pdc_fthick;
-                SDL_FillRect(pdc_screen, &dest, pdc_mapped[hcol]);
-                dest.x -= pdc_fwidth - pdc_fthick;
-            }
-        }
+    if (n > MAX_WORKERS)
+        n = MAX_WORKERS;
 
-        dest.x += pdc_fwidth;
-    }
+    pool_lock = SDL_CreateMutex();
+    work_ready = SDL_CreateCond();
+    work_done = SDL_CreateCond();
 
-#ifdef PDC_WIDE
-    if (pdc_font)
+    if (!pool_lock || !work_ready || !work_done)
     {
-        SDL_FreeSurface(pdc_font);
-        pdc_font = NULL;
+        PDC_stop_workers();
+        return;
     }
-#endif
 
-    if (!blink && (attr & A_UNDERLINE))
+    pool_stop = FALSE;
+
+    SDL_LockMutex(pool_lock);
+    start_generation = generation;
+    SDL_UnlockMutex(pool_lock);
+
+    for (n_workers = 0; n_workers < n; n_workers++)
     {
-        dest.y += pdc_fheight - pdc_fthick;
-        dest.x = pdc_fwidth * x + pdc_xoffset;
-        dest.h = pdc_fthick;
-        dest.w = pdc_fwidth * len;
+        workers[n_workers] = SDL_CreateThread(_worker, "PDCurses",
+                                              (void *)(size_t)(n_workers + 1));
+        if (!workers[n_workers])
+            break;
+    }
 
-        SDL_FillRect(pdc_screen, &dest, pdc_mapped[hcol]);
+    /* if some threads couldn't be created, the bands are drawn by the
+       ones that were */
+}
+
+void PDC_stop_workers(void)
+{
+    int i;
+
+    _flush_packets();
+
+    if (pool_lock)
+    {
+        SDL_LockMutex(pool_lock);
+        pool_stop = TRUE;
+        SDL_CondBroadcast(work_ready);
+        SDL_UnlockMutex(pool_lock);
     }
+
+    for (i = 0; i < n_workers; i++)
+        SDL_WaitThread(workers[i], NULL);
+
+    n_workers = 0;
+
+    SDL_DestroyCond(work_done);
+    SDL_DestroyCond(work_ready);
+    SDL_DestroyMutex(pool_lock);
+    work_done = work_ready = NULL;
+    pool_lock = NULL;
 }
 
 /* update the given physical line to look like the corresponding line in
@@ -573,8 +1386,8 @@ void PDC_pump_and_peep(void)
             (SDL_WINDOWEVENT_RESTORED == event.window.event ||
              SDL_WINDOWEVENT_EXPOSED == event.window.event))
         {
-            SDL_UpdateWindowSurface(pdc_window);
-            rectcount = 0;
+            _update_window(NULL, 0);
+            _clear_damage();
         }
         else
             SDL_PushEvent(&event);
@@ -4,8 +4,17 @@
 
 #include <ctype.h>
 #include <string.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <SDL_syswm.h>
+#endif
 
 static SDL_Event event;
+#ifndef _WIN32
+static int wake_pipe[2] = {-1, -1};
+static SDL_atomic_t wake_pending;
+#endif
 static SDL_Keycode oldkey;
 static MOUSE_STATUS old_mouse_status;
 
@@ -83,6 +92,16 @@ bool PDC_check_key(void)
 {
     int haveevent;
 
+#ifndef _WIN32
+    if (wake_pipe[0] >= 0 && SDL_AtomicGet(&wake_pending))
+    {
+        char buf[64];
+
+        while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+            ;
+        SDL_AtomicSet(&wake_pending, 0);
+    }
+#endif
     PDC_pump_and_peep();
 
     /* SDL_TEXTINPUT can return multiple chars from the IME which we
@@ -96,6 +115,64 @@ bool PDC_check_key(void)
     return haveevent;
 }
 
+/* sleep until an event arrives, or ms milliseconds (ms < 0: forever) */
+
+bool PDC_wait_for_input(int ms)
+{
+    if (event.type == SDL_TEXTINPUT && event.text.text[0])
+        return TRUE;
+
+    return SDL_WaitEventTimeout(NULL, ms) == 1;
+}
+
+/* A file descriptor for an event loop to wait on. Under X11, that's the
+   X server connection, which is readable whenever the window system
+   has input for us. Elsewhere, it's a pipe that an event watch writes
+   to whenever an event is added to SDL's queue; but window system input
+   only gets there when events are pumped, so there the program should
+   still call PDC_process_input() now and then. */
+
+#ifndef _WIN32
+static int SDLCALL _wake_on_event(void *userdata, SDL_Event *ev)
+{
+    if (!SDL_AtomicSet(&wake_pending, 1))
+        if (write(wake_pipe[1], "", 1) < 0)
+            SDL_AtomicSet(&wake_pending, 0);
+
+    return 1;
+}
+#endif
+
+int PDC_get_input_fd(void)
+{
+#if !defined(_WIN32) && defined(SDL_VIDEO_DRIVER_X11)
+    SDL_SysWMinfo info;
+#endif
+
+    PDC_LOG(("PDC_get_input_fd() - called\n"));
+
+#ifdef _WIN32
+    return -1;
+#else
+# ifdef SDL_VIDEO_DRIVER_X11
+    SDL_VERSION(&info.version);
+    if (SDL_GetWindowWMInfo(pdc_window, &info) &&
+        info.subsystem == SDL_SYSWM_X11)
+        return ConnectionNumber(info.info.x11.display);
+# endif
+    if (wake_pipe[0] < 0)
+    {
+        if (pipe(wake_pipe))
+            return -1;
+        fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+        SDL_AddEventWatch(_wake_on_event, NULL);
+    }
+
+    return wake_pipe[0];
+#endif
+}
+
 #ifdef PDC_WIDE
 static int _utf8_to_unicode(char *chstr, size_t *b)
 {
@@ -370,22 +447,7 @@ static int _process_mouse_event(void)
         if (btn < 1 || btn > 3)
             return -1;
 
-        /* check for a click -- a press followed immediately by a release */
-
-        if (action == BUTTON_PRESSED && SP->mouse_wait)
-        {
-            SDL_Event rel;
-
-            napms(SP->mouse_wait);
-
-            if (SDL_PollEvent(&rel))
-            {
-                if (rel.type == SDL_MOUSEBUTTONUP && rel.button.button == btn)
-                    action = BUTTON_CLICKED;
-                else
-                    SDL_PushEvent(&rel);
-            }
-        }
+        /* clicks are made from the press and release in the core */
 
         btn--;
 
@@ -410,7 +472,7 @@ int PDC_get_key(void)
     case SDL_WINDOWEVENT:
         if (SDL_WINDOWEVENT_SIZE_CHANGED == event.window.event)
         {
-            pdc_screen = SDL_GetWindowSurface(pdc_window);
+            PDC_get_screen();
             pdc_sheight = pdc_screen->h - pdc_xoffset;
             pdc_swidth = pdc_screen->w - pdc_yoffset;
             touchwin(curscr);
@@ -3,6 +3,7 @@
 #include "pdcsdl.h"
 
 #include <stdlib.h>
+#include <string.h>
 #ifndef PDC_WIDE
 # include "../common/font437.h"
 #endif
@@ -36,19 +37,31 @@ SDL_Color pdc_color[PDC_MAXCOL];
 Uint32 pdc_mapped[PDC_MAXCOL];
 int pdc_fheight, pdc_fwidth, pdc_fthick, pdc_flastc;
 bool pdc_own_window;
+SDL_Renderer *pdc_renderer = NULL;
+SDL_Texture *pdc_texture = NULL;
 
 /* special purpose function keys */
 static int PDC_shutdown_key[PDC_MAX_FUNCTION_KEYS] = { 0, 0, 0, 0, 0 };
 
 static void _clean(void)
 {
+    PDC_stop_workers();
 #ifdef PDC_WIDE
     if (pdc_ttffont)
     {
+        PDC_flush_glyphs();
         TTF_CloseFont(pdc_ttffont);
         TTF_Quit();
     }
+#else
+    PDC_flush_sheets();
 #endif
+    if (pdc_renderer)
+    {
+        SDL_FreeSurface(pdc_screen);
+        SDL_DestroyTexture(pdc_texture);
+        SDL_DestroyRenderer(pdc_renderer);
+    }
     SDL_FreeSurface(pdc_tileback);
     SDL_FreeSurface(pdc_back);
     SDL_FreeSurface(pdc_icon);
@@ -96,6 +109,7 @@ void PDC_scr_close(void)
 
 void PDC_scr_free(void)
 {
+    PDC_stop_workers();
 }
 
 static void _initialize_colors(void)
@@ -290,12 +304,22 @@ int PDC_scr_open(void)
 
         SDL_SetWindowIcon(pdc_window, pdc_icon);
 
+        /* "software" asks for SDL's software renderer, and "vsync" to
+           have presentation synchronized with the display's refresh;
+           any other value, for whatever renderer SDL prefers */
+
+        env = getenv("PDC_RENDERER");
+        if (env)
+            pdc_renderer = SDL_CreateRenderer(pdc_window, -1,
+                !strcmp(env, "software") ? SDL_RENDERER_SOFTWARE :
+                !strcmp(env, "vsync") ? SDL_RENDERER_PRESENTVSYNC : 0);
+
         /* Events must be pumped before calling SDL_GetWindowSurface, or
            initial modifiers (e.g. numlock) will be ignored and out-of-sync. */
 
         SDL_PumpEvents();
 
-        pdc_screen = SDL_GetWindowSurface(pdc_window);
+        PDC_get_screen();
 
         if (pdc_screen == NULL)
         {
@@ -332,6 +356,8 @@ int PDC_scr_open(void)
 
     SDL_StartTextInput();
 
+    PDC_start_workers();
+
     PDC_mouse_set();
 
     SP->mouse_wait = PDC_CLICK_PERIOD;
@@ -374,7 +400,7 @@ int PDC_resize_screen(int nlines, int ncols)
         pdc_swidth = ncols * pdc_fwidth;
 
         SDL_SetWindowSize(pdc_window, pdc_swidth, pdc_sheight);
-        pdc_screen = SDL_GetWindowSurface(pdc_window);
+        PDC_get_screen();
     }
 
     if (pdc_tileback)
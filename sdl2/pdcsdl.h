@@ -19,6 +19,8 @@ PDCEX  SDL_Window *pdc_window;
 PDCEX  SDL_Surface *pdc_screen, *pdc_font, *pdc_icon, *pdc_back;
 PDCEX  int pdc_sheight, pdc_swidth, pdc_yoffset, pdc_xoffset;
 
+extern SDL_Renderer *pdc_renderer;  /* if PDC_RENDERER is set */
+extern SDL_Texture *pdc_texture;     /* streaming copy of pdc_screen */
 extern SDL_Surface *pdc_tileback;    /* used to regenerate the background
                                         of "transparent" cells */
 extern SDL_Color pdc_color[PDC_MAXCOL];  /* colors for font palette */
@@ -36,5 +38,13 @@ extern bool pdc_own_window;          /* if pdc_window was not set
 PDCEX  void PDC_update_rects(void);
 PDCEX  void PDC_retile(void);
 
+extern void PDC_get_screen(void);
+extern void PDC_start_workers(void);
+extern void PDC_stop_workers(void);
 extern void PDC_pump_and_peep(void);
 extern void PDC_blink_text(void);
+#ifdef PDC_WIDE
+extern void PDC_flush_glyphs(void);
+#else
+extern void PDC_flush_sheets(void);
+#endif
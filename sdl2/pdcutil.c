@@ -9,16 +9,30 @@ void PDC_beep(void)
 
 void PDC_napms(int ms)
 {
+    Uint32 end = SDL_GetTicks() + ms;
+    Sint32 remaining;
+
     PDC_LOG(("PDC_napms() - called: ms=%d\n", ms));
 
-    while (ms > 50)
+    /* Sleep in SDL_WaitEventTimeout(), so that an exposure is redrawn
+       as soon as it arrives. Once other events are waiting (which only
+       wgetch() will take out of the queue), that would return at once,
+       so sleep in slices of at most 50 ms instead, pumping between. */
+
+    PDC_pump_and_peep();
+    while ((remaining = (Sint32)(end - SDL_GetTicks())) > 0)
     {
+        if (SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT))
+            SDL_Delay(remaining < 50 ? remaining : 50);
+        else
+            SDL_WaitEventTimeout(NULL, remaining);
         PDC_pump_and_peep();
-        SDL_Delay(50);
-        ms -= 50;
     }
-    PDC_pump_and_peep();
-    SDL_Delay(ms);
+}
+
+long PDC_millisecs(void)
+{
+    return (long)SDL_GetTicks();
 }
 
 const char *PDC_sysname(void)
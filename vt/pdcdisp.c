@@ -14,25 +14,450 @@
 #include "../common/acs_defs.h"
 #include "../common/pdccolor.h"
 
-                   /* Rarely,  writes to stdout fail if a signal handler is
-                      called.  In which case we just try to write out the
-                      remainder of the buffer until success happens.     */
+/* All output goes into 'queue',  and is written out with write(2) in
+PDC_doupdate() (or sooner,  if the queue gets large).  Normally,  we wait
+until all of it has been written.  With 'NONBLOCK' in PDC_VT,  stdout is put
+in non-blocking mode instead,  and whatever the terminal (or the SSH link
+to it) can't take yet just stays queued.
+
+   If,  when a frame starts,  more than a screenful of bytes is still
+queued,  the frame is dropped : nothing is sent,  and the cells it would
+have drawn are remembered.  PDC_doupdate() then marks those cells as
+'unknown' in SP->lastscr and touches them in curscr,  so the first frame
+that does get sent is one diff against what the terminal actually
+received.  Slow links thus get fewer frames,  rather than ever-older ones.
+
+   Built with THREADS=Y,  the queue is instead handed to a writer thread at
+the end of each frame,  and doupdate() returns without waiting for it to
+be written.  If the writer is still more than a screenful behind when the
+next frame starts,  that frame is dropped,  just as above;  once the
+writer has caught up,  it wakes the main thread (through the input
+thread's wake-up pipe;  see pdckbd.c),  which sends a single frame with
+everything that was skipped. */
+
+#if !defined( _WIN32) && !defined( DOS)
+   #define USE_TERMIOS
+   #include <unistd.h>
+   #include <fcntl.h>
+   #include <signal.h>
+   #include <sys/select.h>
+#endif
+#ifdef USE_WRITER_THREAD
+   #include <pthread.h>
+#endif
+
+#define QUEUE_FLUSH_SIZE  65536
+
+static char *queue = NULL;
+static size_t queue_len = 0, queue_alloced = 0;
+static bool nonblocking = FALSE;
+static bool in_frame = FALSE, dropping_frame = FALSE, redraw_pending = FALSE;
+static int *drop_first = NULL, *drop_last = NULL, n_drop_lines = 0;
+
+#ifdef USE_WRITER_THREAD
+      /* Output handed over to the writer :  'pending' bytes in out_buff
+         that it hasn't taken yet,  plus 'writing' it's busy with.  All of
+         this is guarded by writer_lock. */
+
+static pthread_t writer;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t output_written = PTHREAD_COND_INITIALIZER;
+static char *out_buff = NULL;
+static size_t pending = 0, out_alloced = 0, writing = 0;
+static bool writer_running = FALSE, stop_writer = FALSE;
+static bool wake_when_written = FALSE;
+#endif
+
+#ifdef USE_TERMIOS
+static void write_to_stdout( const char *buff, size_t len,
+                             const bool wait_for_completion, size_t *written)
+{
+    *written = 0;
+    while( *written < len)
+    {
+        const ssize_t rval = write( STDOUT_FILENO, buff + *written,
+                                    len - *written);
+
+        if( rval > 0)
+            *written += (size_t)rval;
+        else if( rval < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            fd_set wrset;
+
+            if( !wait_for_completion)
+                break;
+            FD_ZERO( &wrset);
+            FD_SET( STDOUT_FILENO, &wrset);
+            select( STDOUT_FILENO + 1, NULL, &wrset, NULL, NULL);
+        }
+        else if( rval < 0 && errno != EINTR)
+            *written = len;        /* hopeless;  just discard it */
+    }
+}
+#endif
+
+#ifdef USE_WRITER_THREAD
+static void *writer_thread( void *unused)
+{
+    char *buff = NULL;
+    size_t alloced = 0, written;
+
+    pthread_mutex_lock( &writer_lock);
+    for( ;;)
+    {
+        char *swap_buff;
+        size_t swap_alloced;
+
+        while( !pending && !stop_writer)
+            pthread_cond_wait( &output_ready, &writer_lock);
+        if( !pending)
+            break;
+        swap_buff = out_buff;       /* take the output,  and leave our */
+        swap_alloced = out_alloced; /* (empty) buffer in its place */
+        out_buff = buff;
+        out_alloced = alloced;
+        buff = swap_buff;
+        alloced = swap_alloced;
+        writing = pending;
+        pending = 0;
+        pthread_mutex_unlock( &writer_lock);
+
+        write_to_stdout( buff, writing, TRUE, &written);
+
+        pthread_mutex_lock( &writer_lock);
+        writing = 0;
+        pthread_cond_broadcast( &output_written);
+        if( wake_when_written && !pending)
+        {
+            wake_when_written = FALSE;
+            PDC_wake_input( );
+        }
+    }
+    pthread_mutex_unlock( &writer_lock);
+    free( buff);
+    return( NULL);
+}
+
+static size_t writer_backlog( void)
+{
+    size_t rval;
+
+    pthread_mutex_lock( &writer_lock);
+    rval = pending + writing;
+    pthread_mutex_unlock( &writer_lock);
+    return( rval);
+}
+
+      /* Hands the queue to the writer,  and optionally waits for it (and
+         whatever it already had) to be written.  */
+
+static void pass_queue_to_writer( const bool wait_for_completion)
+{
+    pthread_mutex_lock( &writer_lock);
+    if( pending + queue_len > out_alloced)
+    {
+        char *new_buff;
+        const size_t new_alloced = (pending + queue_len) * 2 + 1024;
+
+        new_buff = (char *)realloc( out_buff, new_alloced);
+        if( !new_buff)       /* hold on to the queue,  and try again later */
+        {
+            pthread_mutex_unlock( &writer_lock);
+            return;
+        }
+        out_buff = new_buff;
+        out_alloced = new_alloced;
+    }
+    memcpy( out_buff + pending, queue, queue_len);
+    pending += queue_len;
+    queue_len = 0;
+    pthread_cond_signal( &output_ready);
+    if( wait_for_completion)
+        while( pending || writing)
+            pthread_cond_wait( &output_written, &writer_lock);
+    pthread_mutex_unlock( &writer_lock);
+}
+
+      /* Called after a frame was dropped :  once the writer is done,  the
+         main thread should wake up,  and send the cells skipped.  */
+
+static void wake_when_caught_up( void)
+{
+    bool wake_now;
+
+    pthread_mutex_lock( &writer_lock);
+    wake_now = !(pending + writing);
+    wake_when_written = !wake_now;
+    pthread_mutex_unlock( &writer_lock);
+    if( wake_now)
+        PDC_wake_input( );
+}
+
+void PDC_start_writer( void)
+{
+    sigset_t all_signals, old_mask;
+
+    if( writer_running)
+        return;
+    stop_writer = FALSE;
+    sigfillset( &all_signals);       /* signals go to the main thread */
+    pthread_sigmask( SIG_SETMASK, &all_signals, &old_mask);
+    writer_running = !pthread_create( &writer, NULL, writer_thread, NULL);
+    pthread_sigmask( SIG_SETMASK, &old_mask, NULL);
+}
+
+      /* Output still queued is written first.  */
+
+void PDC_stop_writer( void)
+{
+    if( writer_running)
+    {
+        pass_queue_to_writer( FALSE);
+        pthread_mutex_lock( &writer_lock);
+        stop_writer = TRUE;
+        pthread_cond_signal( &output_ready);
+        pthread_mutex_unlock( &writer_lock);
+        pthread_join( writer, NULL);
+        writer_running = FALSE;
+    }
+}
+#endif
+
+        /* Should doupdate() wait for output to be written?  Not if it's
+           non-blocking,  or if the writer thread is doing the waiting. */
+
+static bool waiting_for_output( void)
+{
+#ifdef USE_WRITER_THREAD
+    if( writer_running)
+        return( FALSE);
+#endif
+    return( !nonblocking);
+}
+
+static void write_queue( const bool wait_for_completion)
+{
+#ifdef USE_TERMIOS
+    size_t written;
+
+#ifdef USE_WRITER_THREAD
+    if( writer_running)
+    {
+        pass_queue_to_writer( wait_for_completion);
+        return;
+    }
+#endif
+    write_to_stdout( queue, queue_len, wait_for_completion, &written);
+    queue_len -= written;
+    if( queue_len)
+        memmove( queue, queue + written, queue_len);
+#else
+    fwrite( queue, 1, queue_len, stdout);
+    fflush( stdout);
+    queue_len = 0;
+#endif
+}
+
 static void put_to_stdout( const char *buff, size_t bytes_out)
 {
-    while( bytes_out)
+    if( queue_len + bytes_out > queue_alloced)
+    {
+        char *new_queue;
+
+        queue_alloced = (queue_len + bytes_out) * 2 + 1024;
+        new_queue = (char *)realloc( queue, queue_alloced);
+        if( !new_queue)
+        {
+            write_queue( TRUE);
+            fwrite( buff, 1, bytes_out, stdout);
+            fflush( stdout);
+            return;
+        }
+        queue = new_queue;
+    }
+    memcpy( queue + queue_len, buff, bytes_out);
+    queue_len += bytes_out;
+    if( queue_len > QUEUE_FLUSH_SIZE && !nonblocking)
+        write_queue( waiting_for_output( ));
+}
+
+void PDC_puts_to_stdout( const char *buff)
+{
+    put_to_stdout( buff, strlen( buff));
+}
+
+static size_t congestion_threshold( void)
+{
+    const size_t screenful = (size_t)( SP->lines * SP->cols);
+
+    return( screenful > 4096 ? screenful : 4096);
+}
+
+void PDC_set_nonblocking_output( const bool on)
+{
+#ifdef USE_TERMIOS
+    static int orig_flags = -1;
+
+    if( on && !nonblocking)
+    {
+        orig_flags = fcntl( STDOUT_FILENO, F_GETFL);
+        if( orig_flags != -1 && fcntl( STDOUT_FILENO, F_SETFL,
+                                      orig_flags | O_NONBLOCK) != -1)
+            nonblocking = TRUE;
+    }
+    else if( !on && nonblocking)
+    {
+        write_queue( TRUE);
+        fcntl( STDOUT_FILENO, F_SETFL, orig_flags);
+        nonblocking = FALSE;
+    }
+#endif
+    if( !on)
+        write_queue( TRUE);
+}
+
+static void note_dropped_cells( const int lineno, const int x, const int len)
+{
+    if( n_drop_lines != SP->lines)
     {
-        const size_t bytes_written = fwrite( buff, 1, bytes_out, stdout);
+        int i;
+
+        n_drop_lines = SP->lines;
+        drop_first = (int *)realloc( drop_first, n_drop_lines * sizeof( int));
+        drop_last = (int *)realloc( drop_last, n_drop_lines * sizeof( int));
+        if( !drop_first || !drop_last)
+        {
+            n_drop_lines = 0;
+            return;
+        }
+        for( i = 0; i < n_drop_lines; i++)
+            drop_first[i] = drop_last[i] = _NO_CHANGE;
+    }
+    if( drop_first[lineno] == _NO_CHANGE || drop_first[lineno] > x)
+        drop_first[lineno] = x;
+    if( drop_last[lineno] < x + len - 1)
+        drop_last[lineno] = x + len - 1;
+}
+
+        /* Called at the end of a dropped frame : the cells we didn't send
+           are made to differ from curscr in SP->lastscr,  and touched in
+           curscr,  so the next doupdate() will send them. */
+
+static void redo_dropped_cells( void)
+{
+    int y, x;
 
-        buff += bytes_written;
-        bytes_out -= bytes_written;
-        if( bytes_out)
-            assert( errno == EINTR);
+    for( y = 0; y < n_drop_lines && y < SP->lines; y++)
+        if( drop_first[y] != _NO_CHANGE)
+        {
+            for( x = drop_first[y]; x <= drop_last[y]; x++)
+                SP->lastscr->_y[y][x] = ~curscr->_y[y][x];
+            if( curscr->_firstch[y] == _NO_CHANGE
+                              || curscr->_firstch[y] > drop_first[y])
+                curscr->_firstch[y] = drop_first[y];
+            if( curscr->_lastch[y] < drop_last[y])
+                curscr->_lastch[y] = drop_last[y];
+            drop_first[y] = drop_last[y] = _NO_CHANGE;
+        }
+    redraw_pending = TRUE;
+}
+
+        /* TRUE if non-blocking output is still queued,  i.e.,  if someone
+           waiting for input should also wake up when stdout is writable. */
+
+bool PDC_output_pending( void)
+{
+    return( nonblocking && queue_len > 0);
+}
+
+        /* Called while waiting for input : send what we can of the queue,
+           and if a frame was dropped and the queue has since drained,
+           send the cells that were skipped. */
+
+void PDC_drain_output( void)
+{
+#ifdef USE_WRITER_THREAD
+    if( writer_running)
+    {
+        if( redraw_pending && !in_frame
+                     && writer_backlog( ) < congestion_threshold( ))
+        {
+            redraw_pending = FALSE;
+            doupdate( );
+        }
+        return;
+    }
+#endif
+    if( !nonblocking)
+        return;
+    if( queue_len)
+        write_queue( FALSE);
+    if( redraw_pending && !in_frame && queue_len < congestion_threshold( ))
+    {
+        redraw_pending = FALSE;
+        doupdate( );
     }
 }
 
+        /* Synchronized output (DEC private mode 2026) :  on terminals that
+           support it,  each frame is bracketed by 'begin/end synchronized
+           update' so it is shown all at once,  with no tearing.  The
+           'begin' is only sent when the first cell of a frame is output,
+           so a doupdate() that changes nothing sends nothing.  */
+#define SYNC_BEGIN    "\033[?2026h"
+#define SYNC_END      "\033[?2026l"
+
+static bool in_sync_frame = FALSE;
+
+static void begin_frame( void)
+{
+   if( in_frame)
+      return;
+   in_frame = TRUE;
+#ifdef USE_WRITER_THREAD
+   if( writer_running)
+      dropping_frame = (writer_backlog( ) > congestion_threshold( ));
+   else
+#endif
+   if( nonblocking && queue_len)
+      {
+      write_queue( FALSE);
+      dropping_frame = (queue_len > congestion_threshold( ));
+      }
+   if( (PDC_vt_features & PDC_VT_SYNC) && !dropping_frame)
+      {
+      put_to_stdout( SYNC_BEGIN, strlen( SYNC_BEGIN));
+      in_sync_frame = TRUE;
+      }
+}
+
+static void end_frame( void)
+{
+   if( in_sync_frame)
+      {
+      put_to_stdout( SYNC_END, strlen( SYNC_END));
+      in_sync_frame = FALSE;
+      }
+   if( dropping_frame)
+      {
+      redo_dropped_cells( );
+#ifdef USE_WRITER_THREAD
+      if( writer_running)
+         wake_when_caught_up( );
+#endif
+      }
+   in_frame = dropping_frame = FALSE;
+}
+
 void PDC_gotoyx(int y, int x)
 {
-   printf( "\033[%d;%dH", y + 1, x + 1);
+   char tbuff[30];
+
+   if( dropping_frame)
+      return;
+   sprintf( tbuff, "\033[%d;%dH", y + 1, x + 1);
+   put_to_stdout( tbuff, strlen( tbuff));
 }
 
 #define ITALIC_ON     "\033[3m"
@@ -58,12 +483,11 @@ const chtype MAX_UNICODE = 0x110000;
 
 static void color_string( char *otext, const PACKED_RGB rgb)
 {
-   extern bool PDC_has_rgb_color;      /* pdcscrn.c */
    const int red = Get_RValue( rgb);
    const int green = Get_GValue( rgb);
    const int blue = Get_BValue( rgb);
 
-   if( PDC_has_rgb_color)
+   if( PDC_vt_features & PDC_VT_RGB)
       sprintf( otext, "2;%d;%d;%dm", red, green, blue);
    else
       {
@@ -146,6 +570,19 @@ int PDC_wc_to_utf8( char *dest, const int32_t code);
 #define RUN_LEN      20
 #define OBUFF_SIZE   80
 
+      /* REP (CSI Pn b) repeats the preceding character Pn times.  It's used
+         when the copies it replaces would take more than REP_MIN_BYTES. */
+#define REP_MIN_BYTES 6
+
+static int n_repeats( const chtype *srcp, const int len)
+{
+    int n = 1;
+
+    while( n < len && srcp[n] == *srcp)
+        n++;
+    return( n - 1);
+}
+
 void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 {
     static chtype prev_ch = 0;
@@ -159,6 +596,12 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
         put_to_stdout( reset_all, strlen( reset_all));
         return;
     }
+    begin_frame( );
+    if( dropping_frame)
+    {
+        note_dropped_cells( lineno, x, len);
+        return;
+    }
     while( len > RUN_LEN)     /* break input into RUN_LEN character blocks */
     {
         PDC_transform_line( lineno, x, RUN_LEN, srcp);
@@ -206,33 +649,53 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
        if( ch > (int)MAX_UNICODE)      /* chars & fullwidth supported */
        {
            cchar_t root, newchar;
+           char obuff[OBUFF_SIZE];
 
            root = ch;
            while( (root = PDC_expand_combined_characters( root,
                               &newchar)) > MAX_UNICODE)
                ;
-           printf( "%lc", (wchar_t)root);
+           put_to_stdout( obuff, PDC_wc_to_utf8( obuff, (wchar_t)root));
            root = ch;
            while( (root = PDC_expand_combined_characters( root,
                               &newchar)) > MAX_UNICODE)
-               printf( "%lc", (wchar_t)newchar);
-           printf( "%lc", (wchar_t)newchar);
+               put_to_stdout( obuff, PDC_wc_to_utf8( obuff, (wchar_t)newchar));
+           put_to_stdout( obuff, PDC_wc_to_utf8( obuff, (wchar_t)newchar));
        }
        else if( ch < (int)MAX_UNICODE)
 #endif
        {
-           size_t bytes_out;
+           size_t bytes_out, char_bytes;
            char obuff[OBUFF_SIZE];
 
-           bytes_out = PDC_wc_to_utf8( obuff, (wchar_t)ch);
-           while( count < len && !((srcp[0] ^ srcp[count]) & ~A_CHARTEXT)
-                        && (ch = (srcp[count] & A_CHARTEXT)) < MAX_UNICODE)
+           bytes_out = char_bytes = PDC_wc_to_utf8( obuff, (wchar_t)ch);
+           for( ;;)
            {
+               if( PDC_vt_features & PDC_VT_REP)
+               {
+                   const int reps = n_repeats( srcp + count - 1,
+                                               len - count + 1);
+
+                   if( reps * char_bytes > REP_MIN_BYTES)
+                   {
+                       char rep_text[20];
+
+                       put_to_stdout( obuff, bytes_out);
+                       bytes_out = 0;
+                       sprintf( rep_text, "\033[%db", reps);
+                       put_to_stdout( rep_text, strlen( rep_text));
+                       count += reps;
+                   }
+               }
+               if( count >= len || ((srcp[0] ^ srcp[count]) & ~A_CHARTEXT)
+                        || (ch = (srcp[count] & A_CHARTEXT)) >= (int)MAX_UNICODE)
+                   break;
                if( (srcp[count] & A_ALTCHARSET) && ch < 0x80)
                   ch = (int)acs_map[ch & 0x7f];
                if( ch < (int)' ' || (ch >= 0x80 && ch <= 0x9f))
                   ch = ' ';
-               bytes_out += PDC_wc_to_utf8( obuff + bytes_out, (wchar_t)ch);
+               char_bytes = PDC_wc_to_utf8( obuff + bytes_out, (wchar_t)ch);
+               bytes_out += char_bytes;
                assert( bytes_out <= OBUFF_SIZE);
                count++;
            }
@@ -246,5 +709,6 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 
 void PDC_doupdate(void)
 {
-    fflush( stdout);
+    end_frame( );
+    write_queue( waiting_for_output( ));
 }
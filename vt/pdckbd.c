@@ -1,14 +1,23 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #if defined( _WIN32) || defined( DOS)
    #include <conio.h>
    #define USE_CONIO
 #else
-   #include <sys/select.h>
+   #include <errno.h>
+   #include <signal.h>
    #include <unistd.h>
+   #include <sys/select.h>
 #endif
 #include "curspriv.h"
+#include "pdcvt.h"
+#ifdef USE_READER_THREAD
+   #include <fcntl.h>
+   #include <pthread.h>
+   #include <stdatomic.h>
+#endif
 
 #if defined( __BORLANDC__) || defined( DOS)
    #define WINDOWS_VERSION_OF_KBHIT kbhit
@@ -32,26 +41,257 @@ https://www.gnu.org/software/screen/manual/html_node/Control-Sequences.html
 */
 
 extern bool PDC_resize_occurred;
+extern bool PDC_probe_pending;
 
-static bool check_key( int *c)
+#ifndef USE_CONIO
+/* Keyboard (and mouse) input is read in bulk into input_buff,  and bytes
+are then handed out from there.  stdin is set up (in PDC_scr_open()) with
+VMIN = VTIME = 0,  so read() never blocks : it returns whatever is
+available,  or nothing.  So a burst of input -- a mouse report,  fast
+typing,  a paste -- costs one system call,  not two per byte. */
+
+#define INPUT_BUFF_SIZE 1024
+
+static unsigned char input_buff[INPUT_BUFF_SIZE];
+static int input_start = 0, input_end = 0;
+#endif
+
+#ifdef USE_READER_THREAD
+/* With THREADS=Y,  a reader thread sits blocked on stdin,  and copies
+whatever arrives,  stamped with the time it arrived,  into reader_ring.
+That's a single-producer,  single-consumer queue : the thread only moves
+ring_tail and the main thread only moves ring_head,  so no locks are
+needed.  fill_input_buff( ) then takes bytes from the ring,  rather than
+from stdin,  and they're decoded just as before.
+
+   The point is the time stamps.  Without them,  an escape sequence that's
+split across two reads (or that we got around to reading late,  on a busy
+machine) looks just like Escape followed by ordinary keys.  With them,
+bytes of a sequence are those that arrived within ESCDELAY milliseconds
+of the byte before,  however long it took us to look at them;  see
+check_key_in_sequence( ).  ESCDELAY is taken from the environment,  as
+in ncurses.
+
+   The thread says there's input by writing a byte to wake_pipe,  which is
+also what PDC_get_input_fd( ) returns;  SIGWINCH and other signals go to
+the main thread,  as they would without the reader. */
+
+#define READER_RING_SIZE 4096         /* must be a power of two */
+#define DEFAULT_ESCDELAY 100
+
+static unsigned char reader_ring[READER_RING_SIZE];
+static long reader_times[READER_RING_SIZE];
+static atomic_uint ring_head, ring_tail;
+static atomic_int wake_pending;
+static int wake_pipe[2] = { -1, -1}, stop_pipe[2] = { -1, -1};
+static pthread_t reader;
+static bool reader_running = FALSE;
+static long input_times[INPUT_BUFF_SIZE], last_input_time;
+static long escdelay = DEFAULT_ESCDELAY;
+
+static void *reader_thread( void *unused)
 {
-    bool rval;
+   const int STDIN = 0;
+   const int nfds = (stop_pipe[0] > STDIN ? stop_pipe[0] : STDIN) + 1;
+   unsigned char buff[INPUT_BUFF_SIZE];
+
+   for( ;;)
+      {
+      const unsigned tail = atomic_load_explicit( &ring_tail,
+                                             memory_order_relaxed);
+      const unsigned space = READER_RING_SIZE - (tail -
+               atomic_load_explicit( &ring_head, memory_order_acquire));
+      struct timeval ten_ms;
+      fd_set rdset;
+      ssize_t i, n;
+      long t;
+
+      FD_ZERO( &rdset);
+      FD_SET( stop_pipe[0], &rdset);
+      if( space)                 /* if the ring's full,  look again */
+         FD_SET( STDIN, &rdset); /* in ten ms;  the main thread is busy */
+      ten_ms.tv_sec = 0;
+      ten_ms.tv_usec = 10000;
+      if( select( nfds, &rdset, NULL, NULL, (space ? NULL : &ten_ms)) < 0)
+         {
+         if( errno == EINTR)
+            continue;
+         break;
+         }
+      if( FD_ISSET( stop_pipe[0], &rdset))
+         break;
+      if( !FD_ISSET( STDIN, &rdset))
+         continue;
+      n = read( STDIN, buff, (space < sizeof( buff) ? space : sizeof( buff)));
+      if( n <= 0)
+         {
+         if( n < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+         break;                  /* end of input */
+         }
+      t = PDC_millisecs( );
+      for( i = 0; i < n; i++)
+         {
+         reader_ring[(tail + i) & (READER_RING_SIZE - 1)] = buff[i];
+         reader_times[(tail + i) & (READER_RING_SIZE - 1)] = t;
+         }
+      atomic_store_explicit( &ring_tail, tail + (unsigned)n,
+                                             memory_order_release);
+      PDC_wake_input( );
+      }
+   return( NULL);
+}
+
+      /* Wakes the main thread,  if it's waiting for input.  Also used by
+         the writer thread (pdcdisp.c),  when skipped output can be sent. */
+
+void PDC_wake_input( void)
+{
+   if( !atomic_exchange( &wake_pending, 1))
+      if( write( wake_pipe[1], "", 1) < 0)
+         atomic_store( &wake_pending, 0);
+}
+
+static unsigned ring_count( void)
+{
+   return( atomic_load_explicit( &ring_tail, memory_order_acquire)
+         - atomic_load_explicit( &ring_head, memory_order_relaxed));
+}
+
+      /* Called when the ring looks empty.  If the reader has written to
+         wake_pipe,  we empty it,  and look again;  in that order,  so that
+         anything added in between isn't missed. */
+
+static unsigned recheck_ring( void)
+{
+   if( atomic_load( &wake_pending))
+      {
+      char junk[64];
+
+      while( read( wake_pipe[0], junk, sizeof( junk)) > 0)
+         ;
+      atomic_store( &wake_pending, 0);
+      }
+   return( ring_count( ));
+}
+
+static void make_pipe( int *fds)
+{
+   if( fds[0] < 0 && !pipe( fds))
+      {
+      fcntl( fds[0], F_SETFL, O_NONBLOCK);
+      fcntl( fds[1], F_SETFL, O_NONBLOCK);
+      }
+}
+
+void PDC_start_reader( void)
+{
+   const char *env = getenv( "ESCDELAY");
+   sigset_t all_signals, old_mask;
+   char junk[16];
+
+   if( reader_running)
+      return;
+   if( env)
+      escdelay = atol( env);
+   make_pipe( wake_pipe);
+   make_pipe( stop_pipe);
+   if( wake_pipe[0] < 0 || stop_pipe[0] < 0)
+      return;
+   while( read( stop_pipe[0], junk, sizeof( junk)) > 0)
+      ;                       /* left over from the last stop */
+   sigfillset( &all_signals);       /* the thread inherits this mask */
+   pthread_sigmask( SIG_SETMASK, &all_signals, &old_mask);
+   reader_running = !pthread_create( &reader, NULL, reader_thread, NULL);
+   pthread_sigmask( SIG_SETMASK, &old_mask, NULL);
+}
+
+void PDC_stop_reader( void)
+{
+   if( reader_running)
+      {
+      if( write( stop_pipe[1], "", 1) == 1)
+         pthread_join( reader, NULL);
+      else
+         pthread_cancel( reader);
+      reader_running = FALSE;
+      }
+}
+#endif
+
 #ifndef USE_CONIO
+static bool fill_input_buff( void)
+{
     const int STDIN = 0;
-    struct timeval timeout;
-    fd_set rdset;
+    ssize_t bytes_read;
+
+#ifdef USE_READER_THREAD
+    unsigned head, i, n = ring_count( );
+
+    if( !n && reader_running)
+       n = recheck_ring( );
+    if( n || reader_running)      /* bytes left in the ring come first, */
+       {                          /* even if the reader's been stopped */
+       head = atomic_load_explicit( &ring_head, memory_order_relaxed);
+       if( n > INPUT_BUFF_SIZE)
+          n = INPUT_BUFF_SIZE;
+       for( i = 0; i < n; i++)
+          {
+          input_buff[i] = reader_ring[(head + i) & (READER_RING_SIZE - 1)];
+          input_times[i] = reader_times[(head + i) & (READER_RING_SIZE - 1)];
+          }
+       atomic_store_explicit( &ring_head, head + n, memory_order_release);
+       input_start = 0;
+       input_end = (int)n;
+       return( n > 0);
+       }
+#endif
+    do
+        bytes_read = read( STDIN, input_buff, INPUT_BUFF_SIZE);
+    while( bytes_read < 0 && errno == EINTR && !PDC_resize_occurred);
+    input_start = 0;
+    input_end = (bytes_read > 0 ? (int)bytes_read : 0);
+    return( input_end > 0);
+}
+#endif
+
+/* Bytes read while working out what an escape sequence was,  that turned
+out not to belong to it,  are pushed back here,  to be read again. */
+
+#define MAX_PUSHED_BACK 4
 
+static int pushed_back[MAX_PUSHED_BACK];
+static int n_pushed_back = 0;
+
+static void push_back_key( const int c)
+{
+   if( n_pushed_back < MAX_PUSHED_BACK)
+      pushed_back[n_pushed_back++] = c;
+}
+
+static bool check_key( int *c)
+{
+    bool rval;
+
+    if( n_pushed_back)
+       {
+       if( c)
+          *c = pushed_back[--n_pushed_back];
+       return( TRUE);
+       }
+#ifndef USE_CONIO
+    PDC_drain_output( );
     if( PDC_resize_occurred)
        return( TRUE);
-    FD_ZERO( &rdset);
-    FD_SET( STDIN, &rdset);
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 0;
-    if( select( STDIN + 1, &rdset, NULL, NULL, &timeout) > 0)
+    if( input_start < input_end || fill_input_buff( ))
        {
        rval = TRUE;
+#ifdef USE_READER_THREAD
        if( c)
-          *c = getchar( );
+          last_input_time = input_times[input_start];
+#endif
+       if( c)
+          *c = input_buff[input_start++];
        }
     else
        rval = FALSE;
@@ -73,6 +313,111 @@ bool PDC_check_key( void)
    return( check_key( NULL));
 }
 
+/* Reads the next byte of an escape sequence,  mouse report or UTF-8
+character,  i.e.,  one that's expected to follow right on from the byte
+before.  With the reader thread,  it must have arrived within ESCDELAY ms
+of that byte;  if it hasn't arrived yet,  we wait until that time is up
+(counted from when the previous byte came in,  not from now).  Without
+the thread,  it's whatever happens to be there already. */
+
+static bool check_key_in_sequence( int *c)
+{
+#ifdef USE_READER_THREAD
+   if( reader_running && !n_pushed_back)
+      {
+      if( input_start == input_end && !fill_input_buff( ))
+         {
+         const long remaining = last_input_time + escdelay - PDC_millisecs( );
+
+         if( remaining <= 0 || !PDC_wait_for_input( (int)remaining)
+                       || !fill_input_buff( ))
+            return( FALSE);
+         }
+      if( input_times[input_start] - last_input_time > escdelay)
+         return( FALSE);
+      last_input_time = input_times[input_start];
+      *c = input_buff[input_start++];
+      return( TRUE);
+      }
+#endif
+   return( check_key( c));
+}
+
+/* Sleep until input arrives,  or 'ms' milliseconds pass (forever if ms < 0).
+On Unixes,  we select() on stdin,  and on stdout as well if non-blocking
+output is still queued (so it gets sent as soon as the terminal can take
+it).  SIGWINCH is blocked except during the pselect(),  so a resize can't
+slip in between checking PDC_resize_occurred and going to sleep.  */
+
+bool PDC_wait_for_input( int ms)
+{
+#ifndef USE_CONIO
+    const int input_fd = PDC_get_input_fd( );
+    const int nfds = (input_fd > STDOUT_FILENO ? input_fd : STDOUT_FILENO) + 1;
+    fd_set rdset, wrset;
+    struct timespec timeout;
+    sigset_t winch_only, old_mask;
+    int rval;
+
+    if( input_start < input_end || n_pushed_back)
+       return( TRUE);
+#ifdef USE_READER_THREAD
+    if( ring_count( ))
+       return( TRUE);
+#endif
+    sigemptyset( &winch_only);
+    sigaddset( &winch_only, SIGWINCH);
+    sigprocmask( SIG_BLOCK, &winch_only, &old_mask);
+    if( PDC_resize_occurred)
+       rval = 1;
+    else
+       {
+       FD_ZERO( &rdset);
+       FD_SET( input_fd, &rdset);
+       FD_ZERO( &wrset);
+       if( PDC_output_pending( ))
+          FD_SET( STDOUT_FILENO, &wrset);
+       timeout.tv_sec = ms / 1000;
+       timeout.tv_nsec = (ms % 1000) * 1000000L;
+       rval = pselect( nfds, &rdset, &wrset, NULL,
+                        (ms < 0 ? NULL : &timeout), &old_mask);
+       if( rval > 0)
+          rval = FD_ISSET( input_fd, &rdset);
+       }
+    sigprocmask( SIG_SETMASK, &old_mask, NULL);
+    return( rval > 0 || PDC_resize_occurred);
+#else
+    const long t0 = PDC_millisecs( );
+
+    while( !check_key( NULL))
+       {
+       const long remaining = ms - (PDC_millisecs( ) - t0);
+
+       if( ms >= 0 && remaining <= 0)
+          return( FALSE);
+       PDC_napms( (ms < 0 || remaining > 10) ? 10 : (int)remaining);
+       }
+    return( TRUE);
+#endif
+}
+
+/* Input is read from stdin,  so that's what an event loop should watch;
+or,  with the reader thread,  the pipe it writes to when input arrives.
+The conio build doesn't read from a descriptor. */
+
+int PDC_get_input_fd( void)
+{
+#ifdef USE_READER_THREAD
+   if( reader_running)
+      return( wake_pipe[0]);
+#endif
+#ifndef USE_CONIO
+   return( 0);
+#else
+   return( -1);
+#endif
+}
+
 void PDC_flushinp( void)
 {
    int thrown_away_char;
@@ -121,12 +466,27 @@ static int xlate_vt_codes_for_dos( const int key1, const int key2)
 
 #define MAX_COUNT 15
 
-/* Mouse events include six bytes.  First three are
+/* Escape sequences are decoded one byte at a time,  as they come in :
+
+   ESC x                         Alt-x
+   ESC O [params] final          SS3
+   ESC [ [prefix] params final   CSI
 
-ESC [ M
+   'prefix' is an optional '<',  '=',  '>' or '?';  'params' are decimal
+numbers separated by ';' (or ':');  bytes from ' ' to '/' are
+'intermediates',  and 'final' is a byte from '@' to '~'.  Once the final
+byte arrives,  the key comes straight from it (or,  if it's a '~',  from
+the first parameter).  The second parameter,  if any,  is 1 + a bitmask of
+modifiers (1=Shift, 2=Alt, 4=Ctrl),  which picks the Shift/Ctrl/Alt
+version of the key and sets SP->key_modifiers.  So the cost is one step
+per byte,  with no table searches,  and any modifier combination works.
 
-   Next byte is 96 for mouse wheel up,  97 for down,  or (for more
-"traditional" mouse events) 32 plus :
+   Sequences we can't map are still read through to their final byte,
+then dropped;  they don't leak through as Alt-[ followed by junk.
+
+   Mouse events come as CSI M followed by three raw bytes ('traditional'
+encoding),  or as CSI < button ; x ; y M (or m for a release) in SGR
+encoding.  In the 'traditional' encoding,  the first byte is 32 plus :
 
    0 for button 1
    1 for button 2
@@ -135,136 +495,494 @@ ESC [ M
    4 if Shift is pressed
    8 if Alt (Meta) is pressed
    16 if Ctrl is pressed
+   32 for a mouse move
+   64 for a wheel event (button 1 = up, 2 = down)
 
    Note that 'release' doesn't tell you _which_ is released.  If only
 one has been pressed (the usual case),  it's presumably the one you
 released.  If two or more buttons are pressed simultaneously,  the
 "releases" are reported in the numerical order of the buttons,  not
 the order in which they're actually released (which we don't know).
+SGR encoding has the same bits,  minus the 32 offset,  but does say
+which button was released.
 
    My tilt mouse reports 'tilt left' as a left button (1) and 'tilt right'
-as a middle button press.  Wheel events get shift,  alt,  ctrl added in
-(but that doesn't seem to be getting through in PDCurses... to be fixed).
+as a middle button press.  Wheel events get shift,  alt,  ctrl added in.
 Button events only get Ctrl (though I think you might get the other events
 on some terminals).
 
-   "Correct" mouse handling will require that we detect a button-down,
-then hold off for SP->mouse_wait to see if we get a release event.  */
-
-static int xlate_vt_codes( const int *c, const int count)
-{
-   static const int tbl[] =  {
-               KEY_UP,   2, '[', 'A',
-               KEY_DOWN, 2, '[', 'B',
-               KEY_LEFT, 2, '[', 'D',
-               KEY_RIGHT,2, '[', 'C',
-               KEY_HOME, 2, 'O', 'H',
-               KEY_HOME, 2, '[', 'H',
-               KEY_END,  2, 'O', 'F',
-               KEY_END,  2, '[', 'F',
-               KEY_B2,   2, '[', 'E',
-               KEY_BTAB, 2, '[', 'Z',     /* Shift-Tab */
-               KEY_IC,   3, '[', '2', '~',
-               KEY_DC,   3, '[', '3', '~',
-               KEY_PPAGE, 3, '[', '5', '~',
-               KEY_NPAGE, 3, '[', '6', '~',
-
-               CTL_LEFT,  5, '[', '1', ';', '5', 'D',
-               CTL_RIGHT, 5, '[', '1', ';', '5', 'C',
-               CTL_UP,    5, '[', '1', ';', '5', 'A',
-               CTL_DOWN,  5, '[', '1', ';', '5', 'B',
-
-               ALT_PGUP, 5, '[', '5', ';', '3', '~',
-               ALT_PGDN, 5, '[', '6', ';', '3', '~',
-
-               KEY_F(1), 3, '[', '[', 'A',      /* Linux console */
-               KEY_F(2), 3, '[', '[', 'B',
-               KEY_F(3), 3, '[', '[', 'C',
-               KEY_F(4), 3, '[', '[', 'D',
-               KEY_F(5), 3, '[', '[', 'E',
-               KEY_END,  3, '[', '4', '~',
-               KEY_HOME, 3, '[', '1', '~',
-
-               KEY_F(1), 2, 'O', 'P',
-               KEY_F(1), 4, '[', '1', '1', '~',
-               KEY_F(2), 2, 'O', 'Q',
-               KEY_F(2), 4, '[', '1', '2', '~',
-               KEY_F(3), 2, 'O', 'R',
-               KEY_F(3), 4, '[', '1', '3', '~',
-               KEY_F(4), 2, 'O', 'S',
-               KEY_F(4), 4, '[', '1', '4', '~',
-               KEY_F(5), 4, '[', '1', '5', '~',
-               KEY_F(6), 4, '[', '1', '7', '~',
-               KEY_F(7), 4, '[', '1', '8', '~',
-               KEY_F(8), 4, '[', '1', '9', '~',
-               KEY_F(9), 4, '[', '2', '0', '~',
-               KEY_F(10), 4, '[', '2', '1', '~',
-               KEY_F(11), 4, '[', '2', '3', '~',
-               KEY_F(12), 4, '[', '2', '4', '~',
-               KEY_F(13), 5, '[', '1', ';', '2', 'P',      /* shift-f1 */
-               KEY_F(14), 5, '[', '1', ';', '2', 'Q',
-               KEY_F(15), 5, '[', '1', ';', '2', 'R',
-               KEY_F(16), 5, '[', '1', ';', '2', 'S',
-               KEY_F(17), 6, '[', '1', '5', ';', '2', '~',  /* shift-f5 */
-               KEY_F(18), 6, '[', '1', '7', ';', '2', '~',
-               KEY_F(19), 6, '[', '1', '8', ';', '2', '~',
-               KEY_F(20), 6, '[', '1', '9', ';', '2', '~',
-               KEY_F(21), 6, '[', '2', '0', ';', '2', '~',
-               KEY_F(22), 6, '[', '2', '1', ';', '2', '~',
-               KEY_F(23), 6, '[', '2', '3', ';', '2', '~',  /* shift-f11 */
-               KEY_F(24), 6, '[', '2', '4', ';', '2', '~',
-               ALT_UP, 5, '[', '1', ';', '3', 'A',
-               ALT_RIGHT, 5, '[', '1', ';', '3', 'C',
-               ALT_DOWN, 5, '[', '1', ';', '3', 'B',
-               ALT_LEFT, 5, '[', '1', ';', '3', 'D',
-               CTL_UP, 5, '[', '1', ';', '5', 'A',
-               CTL_RIGHT, 5, '[', '1', ';', '5', 'C',
-               CTL_DOWN, 5, '[', '1', ';', '5', 'B',
-               CTL_LEFT, 5, '[', '1', ';', '5', 'D',
-               KEY_SUP, 5, '[', '1', ';', '2', 'A',
-               KEY_SRIGHT, 5, '[', '1', ';', '2', 'C',
-               KEY_SDOWN, 5, '[', '1', ';', '2', 'B',
-               KEY_SLEFT, 5, '[', '1', ';', '2', 'D',
-               0 };
-   int i, rval = -1;
-   const int *tptr;
-
-   if( count == 1)
+   We report presses and releases as they come in;  clicks,  double and
+triple clicks are made from them in the core (see PDC_mouse_event() in
+pdcurses/mouse.c),  without waiting here.  */
+
+#define MAX_PARAMS 8
+
+static struct
+{
+   int idx, x, y, button;
+   bool release;
+} mouse_report;
+
+static int held = 0;       /* bitmask of buttons currently pressed */
+
+      /* Keys for CSI or SS3 sequences ending in a letter */
+
+static int final_byte_key( const int final)
+{
+   switch( final)
+      {
+      case 'A':  return( KEY_UP);
+      case 'B':  return( KEY_DOWN);
+      case 'C':  return( KEY_RIGHT);
+      case 'D':  return( KEY_LEFT);
+      case 'E':  return( KEY_B2);
+      case 'F':  return( KEY_END);
+      case 'H':  return( KEY_HOME);
+      case 'P':  return( KEY_F(1));
+      case 'Q':  return( KEY_F(2));
+      case 'R':  return( KEY_F(3));
+      case 'S':  return( KEY_F(4));
+      case 'Z':  return( KEY_BTAB);       /* Shift-Tab */
+      }
+   return( -1);
+}
+
+      /* Keys for CSI n ~ sequences,  indexed by n */
+
+static const int tilde_keys[] = { -1,
+               KEY_HOME, KEY_IC, KEY_DC, KEY_END,            /*  1- 4 */
+               KEY_PPAGE, KEY_NPAGE, KEY_HOME, KEY_END,      /*  5- 8 */
+               -1, -1, KEY_F(1), KEY_F(2),                   /*  9-12 */
+               KEY_F(3), KEY_F(4), KEY_F(5), -1,             /* 13-16 */
+               KEY_F(6), KEY_F(7), KEY_F(8), KEY_F(9),       /* 17-20 */
+               KEY_F(10), -1, KEY_F(11), KEY_F(12),          /* 21-24 */
+               KEY_F(13), KEY_F(14), -1, KEY_F(15),          /* 25-28 */
+               KEY_F(16), -1, KEY_F(17), KEY_F(18),          /* 29-32 */
+               KEY_F(19), KEY_F(20) };                       /* 33-34 */
+
+#define N_TILDE_KEYS ((int)( sizeof( tilde_keys) / sizeof( tilde_keys[0])))
+
+static const int modified_keys[][4] = {
+   /* unmodified   Shift          Ctrl        Alt */
+   { KEY_UP,       KEY_SUP,       CTL_UP,     ALT_UP },
+   { KEY_DOWN,     KEY_SDOWN,     CTL_DOWN,   ALT_DOWN },
+   { KEY_LEFT,     KEY_SLEFT,     CTL_LEFT,   ALT_LEFT },
+   { KEY_RIGHT,    KEY_SRIGHT,    CTL_RIGHT,  ALT_RIGHT },
+   { KEY_HOME,     KEY_SHOME,     CTL_HOME,   ALT_HOME },
+   { KEY_END,      KEY_SEND,      CTL_END,    ALT_END },
+   { KEY_IC,       KEY_SIC,       CTL_INS,    ALT_INS },
+   { KEY_DC,       KEY_SDC,       CTL_DEL,    ALT_DEL },
+   { KEY_PPAGE,    KEY_SPREVIOUS, CTL_PGUP,   ALT_PGUP },
+   { KEY_NPAGE,    KEY_SNEXT,     CTL_PGDN,   ALT_PGDN },
+   { KEY_B2,       KEY_B2,        CTL_PAD5,   ALT_PAD5 },
+   { 0, 0, 0, 0 } };
+
+      /* 'param' is the xterm-style modifier parameter : 1 + (1 for Shift,
+         2 for Alt,  4 for Ctrl).  With more than one modifier,  Ctrl wins
+         over Alt,  which wins over Shift;  SP->key_modifiers has them all.
+         Function keys follow the ncurses layout : Shift-F1 = F13,
+         Ctrl-F1 = F25,  Ctrl-Shift-F1 = F37,  Alt-F1 = F49. */
+
+static int apply_modifiers( const int key, const int param)
+{
+   const int mods = (param > 1 ? (param - 1) & 7 : 0);
+   int i, column;
+
+   if( mods & 1)
+      SP->key_modifiers |= PDC_KEY_MODIFIER_SHIFT;
+   if( mods & 2)
+      SP->key_modifiers |= PDC_KEY_MODIFIER_ALT;
+   if( mods & 4)
+      SP->key_modifiers |= PDC_KEY_MODIFIER_CONTROL;
+   if( !mods || key < 0)
+      return( key);
+   if( key >= KEY_F(1) && key <= KEY_F(12))
+      switch( mods)
+         {
+         case 1:  return( key + 12);
+         case 4:  return( key + 24);
+         case 5:  return( key + 36);
+         case 2:  return( key + 48);
+         default: return( key);
+         }
+   column = ((mods & 4) ? 2 : ((mods & 2) ? 3 : 1));
+   for( i = 0; modified_keys[i][0]; i++)
+      if( modified_keys[i][0] == key)
+         return( modified_keys[i][column]);
+   return( key);
+}
+
+static int alt_key( const int c)
+{
+   int rval = -1;
+
+   if( c >= 'a' && c <= 'z')
+      rval = ALT_A + c - 'a';
+   else if( c >= '0' && c <= '9')
+      rval = ALT_0 + c - '0';
+   else
+      {
+      const char *text = "',./[];`\x1b\\=-\x0a\x7f";
+      const char *tptr = strchr( text, c);
+      const int codes[] = { ALT_FQUOTE, ALT_COMMA, ALT_STOP, ALT_FSLASH,
+                  ALT_LBRACKET, ALT_RBRACKET,
+                  ALT_SEMICOLON, ALT_BQUOTE, ALT_ESC,
+                  ALT_BSLASH, ALT_EQUAL, ALT_MINUS, ALT_ENTER, ALT_BKSP };
+
+      if( c && tptr)
+          rval = codes[tptr - text];
+      }
+   if( rval == -1)          /* no ALT_ code for it;  return the key */
+      {                     /* itself,  and say Alt was down */
+      SP->key_modifiers |= PDC_KEY_MODIFIER_ALT;
+      rval = c;
+      }
+   return( rval);
+}
+
+static int traditional_mouse_report( void)
+{
+   int i, bytes[3];
+
+   for( i = 0; i < 3; i++)
+      if( !check_key_in_sequence( &bytes[i]))
+         return( -1);
+   mouse_report.idx = bytes[0];
+   mouse_report.x = (unsigned char)( bytes[1] - ' ' - 1);
+   mouse_report.y = (unsigned char)( bytes[2] - ' ' - 1);
+   mouse_report.button = bytes[0] & 3;
+   mouse_report.release = (mouse_report.button == 3);
+   if( mouse_report.release)        /* which button was released? */
+      {
+      mouse_report.button = 0;
+      while( mouse_report.button < 3 && !((held >> mouse_report.button) & 1))
+         mouse_report.button++;
+      }
+   return( KEY_MOUSE);
+}
+
+static int sgr_mouse_report( const int *params, const int n_params,
+                                    const int final)
+{
+   int idx = params[0];
+
+   if( n_params != 3)
+      return( -1);
+   mouse_report.button = idx & 3;
+   mouse_report.release = (final == 'm');
+   if( idx & 0x40)            /* (SGR) wheel mouse event; */
+      idx |= 0x20;            /* requires this bit set in 'traditional' encoding */
+   else if( idx & 0x20)       /* (SGR) mouse move event sets a different bit */
+      idx ^= 0x60;            /* in the traditional encoding */
+   mouse_report.idx = idx;
+   mouse_report.x = params[1] - 1;
+   mouse_report.y = params[2] - 1;
+   return( KEY_MOUSE);
+}
+
+/* With bracketed paste (mode 2004) on,  the terminal sends ESC [ 200 ~,
+the pasted text,  then ESC [ 201 ~.  The text is copied out of input_buff
+in bulk,  refilling it as needed,  and handed to PDC_paste_keys( ),  so a
+paste of any size costs a few read( )s and one push onto the input queue,
+rather than a trip through PDC_get_key( ) and wgetch( ) per byte.  Escape
+characters in the text are just text.  If the end marker hasn't shown up
+PASTE_TIMEOUT ms after the last byte,  we go with what we've got. */
+
+      /* Decode UTF-8 text,  as PDC_get_key( ) would,  and hand it to the
+         core as a paste.  Stray bytes that aren't valid UTF-8 come through
+         as they are.  Returns the first key,  or -1 if there are none. */
+
+static int paste_utf8( const unsigned char *text, const long len)
+{
+   int *keys = (int *)malloc( (len ? len : 1) * sizeof( int));
+   long i = 0, n = 0;
+
+   if( !keys)
+      return( -1);
+   while( i < len)
       {
-      if( c[0] >= 'a' && c[0] <= 'z')
-         rval = ALT_A + c[0] - 'a';
-      else if( c[0] >= '0' && c[0] <= '9')
-         rval = ALT_0 + c[0] - '0';
+      const int c = text[i++];
+      int n_more = 0, code = c;
+
+      if( (c & 0xe0) == 0xc0)
+         {
+         n_more = 1;
+         code = c & 0x1f;
+         }
+      else if( (c & 0xf0) == 0xe0)
+         {
+         n_more = 2;
+         code = c & 0xf;
+         }
+      else if( (c & 0xf8) == 0xf0)
+         {
+         n_more = 3;
+         code = c & 0x7;
+         }
+      if( i + n_more > len)
+         n_more = -1;
       else
          {
-         const char *text = "',./[];`\x1b\\=-\x0a\x7f";
-         const char *tptr = strchr( text, c[0]);
-         const int codes[] = { ALT_FQUOTE, ALT_COMMA, ALT_STOP, ALT_FSLASH,
-                     ALT_LBRACKET, ALT_RBRACKET,
-                     ALT_SEMICOLON, ALT_BQUOTE, ALT_ESC,
-                     ALT_BSLASH, ALT_EQUAL, ALT_MINUS, ALT_ENTER, ALT_BKSP };
-
-         if( tptr)
-             rval = codes[tptr - text];
+         int j;
+
+         for( j = 0; j < n_more; j++)
+            if( (text[i + j] & 0xc0) != 0x80)
+               n_more = -1;
+            else
+               code = (code << 6) | (text[i + j] & 0x3f);
          }
+      if( n_more < 0)         /* not valid UTF-8 */
+         code = c;
+      else
+         i += n_more;
+      keys[n++] = code;
       }
-   else if( count == 5 && c[0] == '[' && c[1] == 'M')
-      rval = KEY_MOUSE;
-   else if( count > 6 && c[0] == '[' && c[1] == '<'
-                             && (c[count - 1] == 'M' || c[count - 1] == 'm'))
-      rval = KEY_MOUSE;    /* SGR mouse mode */
-   for( tptr = tbl; rval == -1 && *tptr; tptr += 2 + tptr[1])
-      if( count == tptr[1])
+   return( PDC_paste_keys( keys, n));
+}
+
+#define BRACKETED_PASTE     -2
+#define PASTE_TIMEOUT     1000
+#define INITIAL_PASTE_SIZE 4096
+
+static int read_bracketed_paste( void)
+{
+   static const char end_marker[] = "\033[201~";
+   const int marker_len = (int)sizeof( end_marker) - 1;
+   char *text = NULL;
+   long len = 0, alloced = 0;
+   int matched = 0, rval = -1;
+
+   while( matched < marker_len)
+      {
+      const unsigned char *buff;
+      int i, n;
+#ifndef USE_CONIO
+      if( input_start == input_end && !fill_input_buff( )
+             && !(PDC_wait_for_input( PASTE_TIMEOUT) && fill_input_buff( )))
+         break;
+      buff = input_buff + input_start;
+      n = input_end - input_start;
+#else
+      int c;
+      unsigned char byte;
+
+      if( !check_key( &c)
+             && !(PDC_wait_for_input( PASTE_TIMEOUT) && check_key( &c)))
+         break;
+      byte = (unsigned char)c;
+      buff = &byte;
+      n = 1;
+#endif
+      if( len + n + marker_len > alloced)
          {
-         i = 0;
-         while( i < count && tptr[i + 2] == c[i])
-            i++;
-         if( i == count)
-            rval = tptr[0];
+         char *new_text;
+
+         if( !alloced)
+            alloced = INITIAL_PASTE_SIZE;
+         while( len + n + marker_len > alloced)
+            alloced *= 2;
+         new_text = (char *)realloc( text, alloced);
+         if( !new_text)
+            {
+            free( text);
+            return( -1);
+            }
+         text = new_text;
          }
+      for( i = 0; i < n && matched < marker_len; i++)
+         if( buff[i] == (unsigned char)end_marker[matched])
+            matched++;
+         else
+            {
+            if( matched)      /* false alarm;  it was text after all */
+               {
+               memcpy( text + len, end_marker, matched);
+               len += matched;
+               matched = 0;
+               }
+            if( buff[i] == (unsigned char)end_marker[0])
+               matched = 1;
+            else
+               text[len++] = (char)buff[i];
+            }
+#ifndef USE_CONIO
+      input_start += i;
+#endif
+      }
+   if( text)
+      {
+      if( matched < marker_len)        /* cut off in mid-marker */
+         {
+         memcpy( text + len, end_marker, matched);
+         len += matched;
+         }
+      rval = paste_utf8( (const unsigned char *)text, len);
+      free( text);
+      }
    return( rval);
 }
 
+      /* Called after ESC [ (CSI) or ESC O (SS3),  with the byte following
+         it.  Reads up to and including the final byte.  Returns the key,
+         or -1 if the sequence was unrecognized or cut off. */
+
+static int decode_control_sequence( const bool is_csi, int c)
+{
+   int params[MAX_PARAMS], n_params = 0, prefix = 0, intermediate = 0;
+   int key;
+
+   params[0] = 0;
+   if( c == '<' || c == '=' || c == '>' || c == '?')
+      {
+      prefix = c;
+      if( !check_key_in_sequence( &c))
+         return( -1);
+      }
+   while( c < '@' || c > '~')
+      {
+      if( c >= '0' && c <= '9')
+         {
+         if( !n_params)
+            n_params = 1;
+         if( params[n_params - 1] < 100000)
+            params[n_params - 1] = params[n_params - 1] * 10 + c - '0';
+         }
+      else if( c == ';' || c == ':')
+         {
+         if( !n_params)
+            n_params = 1;
+         if( n_params < MAX_PARAMS)
+            params[n_params++] = 0;
+         }
+      else if( c >= ' ' && c <= '/')
+         intermediate = c;
+      else                    /* not part of a control sequence */
+         return( -1);
+      if( !check_key_in_sequence( &c))
+         return( -1);
+      }
+   if( !is_csi)
+      return( apply_modifiers( final_byte_key( c),
+                               (n_params ? params[n_params - 1] : 0)));
+   if( prefix == '<' && (c == 'M' || c == 'm'))
+      return( sgr_mouse_report( params, n_params, c));
+   if( prefix == '?' && c == 'c')     /* DA1 : the last probe reply */
+      PDC_probe_pending = FALSE;
+   if( prefix || intermediate)
+      return( -1);
+   switch( c)
+      {
+      case 'M':
+         return( n_params ? -1 : traditional_mouse_report( ));
+      case '[':               /* Linux console F1-F5 : ESC [ [ A-E */
+         if( n_params || !check_key_in_sequence( &c))
+            return( -1);
+         return( (c >= 'A' && c <= 'E') ? KEY_F(1) + c - 'A' : -1);
+      case '~':
+         if( params[0] == 200)
+            return( BRACKETED_PASTE);
+         key = (params[0] < N_TILDE_KEYS ? tilde_keys[params[0]] : -1);
+         break;
+      default:
+         key = final_byte_key( c);
+         break;
+      }
+   return( apply_modifiers( key, (n_params > 1 ? params[1] : 0)));
+}
+
+#define CONTROL_STRING_TIMEOUT 200
+
+      /* Reads and drops a DCS or OSC string,  given the last byte read,
+         up to the ST (ESC \) or BEL that ends it.  It may come in more
+         than one read( ),  so we wait a little for the rest. */
+
+static int skip_control_string( int c)
+{
+   bool after_esc = FALSE;
+
+   while( c != 7 && !(after_esc && c == '\\'))
+      {
+      after_esc = (c == 27);
+      if( !check_key_in_sequence( &c)
+             && !(PDC_wait_for_input( CONTROL_STRING_TIMEOUT)
+                        && check_key( &c)))
+         break;
+      }
+   return( -1);
+}
+
+      /* If the startup probe (see pdcscrn.c) timed out,  its replies may
+         still turn up (on a slow ssh link,  say),  and must not be taken
+         for keys.  DCS and OSC replies start with one of these,  after
+         the ESC;  # stands for any digit. */
+
+static const char *reply_prefixes[] = { "P>|", "P!|", "P0+r", "P1+r", "]#" };
+
+#define N_REPLY_PREFIXES \
+            ((int)( sizeof( reply_prefixes) / sizeof( reply_prefixes[0])))
+#define MAX_REPLY_PREFIX 4
+
+      /* Called after ESC P or ESC ],  while probe replies are still due.
+         Reads on as long as the bytes could be the start of a reply.  If
+         they are one,  the rest of the string is dropped and -1 returned.
+         If not,  the bytes after the P or ] are pushed back,  to be read
+         as keys,  and it was just Alt-P or Alt-]. */
+
+static int decode_probe_reply( const int first)
+{
+   int bytes[MAX_REPLY_PREFIX], n = 1;
+
+   bytes[0] = first;
+   for( ;;)
+      {
+      int i, n_partial = 0;
+
+      for( i = 0; i < N_REPLY_PREFIXES; i++)
+         {
+         const char *prefix = reply_prefixes[i];
+         int j = 0;
+
+         while( j < n && prefix[j] && (prefix[j] == '#'
+                        ? (bytes[j] >= '0' && bytes[j] <= '9')
+                        : bytes[j] == prefix[j]))
+            j++;
+         if( j == n)
+            {
+            if( !prefix[n])
+               return( skip_control_string( bytes[n - 1]));
+            n_partial++;
+            }
+         }
+      if( !n_partial || !check_key_in_sequence( bytes + n))
+         break;
+      n++;
+      }
+   while( n > 1)
+      push_back_key( bytes[--n]);
+   return( alt_key( first));
+}
+
+      /* Called after ESC has been read. */
+
+static int decode_escape_sequence( void)
+{
+   int c;
+
+   if( !check_key_in_sequence( &c))
+      return( 27);                /* Escape hit */
+   if( c == '[' || c == 'O')
+      {
+      int c2;
+
+      if( !check_key_in_sequence( &c2))       /* just Alt-[ or Alt-O */
+         return( c == '[' ? ALT_LBRACKET : ALT_O);
+      return( decode_control_sequence( c == '[', c2));
+      }
+   if( PDC_probe_pending && (c == 'P' || c == ']'))
+      return( decode_probe_reply( c));
+   return( alt_key( c));
+}
+
 int PDC_get_key( void)
 {
    int rval = -1;
@@ -274,6 +992,7 @@ int PDC_get_key( void)
       PDC_resize_occurred = FALSE;
       return( KEY_RESIZE);
       }
+   SP->key_modifiers = 0;
    if( check_key( &rval))
       {
       int c[MAX_COUNT];
@@ -294,61 +1013,20 @@ int PDC_get_key( void)
       SP->key_code = (rval == 27);
       if( rval == 27)
          {
-         int count = 0;
-
-         rval = -1;
-         while( rval == -1 && count < MAX_COUNT && check_key( &c[count]))
+         rval = decode_escape_sequence( );
+         if( rval == BRACKETED_PASTE)
             {
-            count++;
-            rval = xlate_vt_codes( c, count);
-            if( rval == ALT_LBRACKET && check_key( NULL))
-               rval = -1;
+            SP->key_code = FALSE;
+            return( read_bracketed_paste( ));
             }
-         if( !count)             /* Escape hit */
-            rval = 27;
-         count--;
+         SP->key_code = (rval >= KEY_MIN);
          if( rval == KEY_MOUSE)
             {
-            int idx, button, flags = 0, i, x, y;
-            static int held = 0;
-            bool release;
+            int idx = mouse_report.idx, button = mouse_report.button;
+            int flags = 0, i;
+            const int x = mouse_report.x, y = mouse_report.y;
+            const bool release = mouse_report.release;
 
-            if( c[1] == 'M')     /* 'traditional' mouse encoding */
-               {
-               x = (unsigned char)( c[3] - ' ' - 1);
-               y = (unsigned char)( c[4] - ' ' - 1);
-               idx = c[2];
-               button = idx & 3;
-               release = (button == 3);
-               if( release)         /* which button was released? */
-                  {
-                  button = 0;
-                  while( button < 3 && !((held >> button) & 1))
-                     button++;
-                  }
-               }
-            else                 /* SGR mouse encoding */
-               {
-               int n_fields, n_bytes, i;
-               char tbuff[MAX_COUNT];
-
-               assert( c[1] == '<');
-               for( i = 0; i < count; i++)
-                  tbuff[i] = (char)c[i];
-               tbuff[count] = '\0';
-               n_fields = sscanf( tbuff + 2, "%d;%d;%d%n", &idx,
-                                                    &x, &y, &n_bytes);
-               assert( n_fields == 3);
-               assert( c[count] == 'M' || c[count] == 'm');
-               release = (c[count] == 'm');
-               button = idx & 3;
-               if( idx & 0x40)            /* (SGR) wheel mouse event; */
-                  idx |= 0x20;            /* requires this bit set in 'traditional' encoding */
-               else if( idx & 0x20)       /* (SGR) mouse move event sets a different bit */
-                  idx ^= 0x60;            /* in the traditional encoding */
-               x--;
-               y--;
-               }
             if( idx & 4)
                flags |= BUTTON_SHIFT;
             if( idx & 8)
@@ -386,32 +1064,12 @@ int PDC_get_key( void)
                   SP->mouse_status.changes =
                         (button ? PDC_MOUSE_WHEEL_DOWN : PDC_MOUSE_WHEEL_UP);
                else     /* "normal" mouse button */
-                  SP->mouse_status.changes = (1 << button);
-               if( !release && !(idx & 64))   /* wait for a possible release */
                   {
-                  int n_events = 0;
-
-                  while( n_events < 6)
-                     {
-                     PDC_napms( SP->mouse_wait);
-                     if( check_key( c))
-                        {
-                        count = 0;
-                        while( count < MAX_COUNT && check_key( &c[count]))
-                           count++;
-                        n_events++;
-                        }
-                     else
-                        break;
-                     }
-                  if( !n_events)   /* just a click,  no release(s) */
-                     held ^= (1 << button);
-                  else if( n_events == 1)
-                      SP->mouse_status.button[button] = BUTTON_CLICKED;
-                  else if( n_events <= 3)
-                      SP->mouse_status.button[button] = BUTTON_DOUBLE_CLICKED;
-                  else if( n_events <= 5)
-                      SP->mouse_status.button[button] = BUTTON_TRIPLE_CLICKED;
+                  SP->mouse_status.changes = (1 << button);
+                  if( release)
+                     held &= ~(1 << button);
+                  else
+                     held |= (1 << button);
                   }
                }
             for( i = 0; i < 3; i++)
@@ -422,21 +1080,21 @@ int PDC_get_key( void)
          }
       else if( (rval & 0xc0) == 0xc0)      /* start of UTF-8 */
          {
-         check_key( &c[0]);
+         check_key_in_sequence( &c[0]);
          assert( (c[0] & 0xc0) == 0x80);
          c[0] &= 0x3f;
          if( !(rval & 0x20))      /* two-byte : U+0080 to U+07ff */
             rval = c[0] | ((rval & 0x1f) << 6);
          else
             {
-            check_key( &c[1]);
+            check_key_in_sequence( &c[1]);
             assert( (c[1] & 0xc0) == 0x80);
             c[1] &= 0x3f;
             if( !(rval & 0x10))   /* three-byte : U+0800 - U+ffff */
                rval = (c[1] | (c[0] << 6) | ((rval & 0xf) << 12));
             else              /* four-byte : U+FFFF - U+10FFFF : SMP */
                {              /* (Supplemental Multilingual Plane) */
-               check_key( &c[2]);
+               check_key_in_sequence( &c[2]);
                assert( (c[2] & 0xc0) == 0x80);
                c[2] &= 0x3f;
                rval = (c[2] | (c[1] << 6) | (c[0] << 12) | ((rval & 0xf) << 18));
@@ -474,8 +1132,6 @@ sort of filtering at a higher level for a reason.  */
 
 int PDC_mouse_set( void)
 {
-   extern bool PDC_is_ansi;
-
    if( !PDC_is_ansi)
       {
       static int curr_tracking_state = -1;
@@ -489,10 +1145,18 @@ int PDC_mouse_set( void)
          tracking_state = (SP->_trap_mbe ? 1000 : 0);
       if( curr_tracking_state != tracking_state)
          {
+         char tbuff[20];
+
          if( curr_tracking_state > 0)
-            printf( "\033[?%dl", curr_tracking_state);
+            {
+            sprintf( tbuff, "\033[?%dl", curr_tracking_state);
+            PDC_puts_to_stdout( tbuff);
+            }
          if( tracking_state)
-            printf( "\033[?%dh", tracking_state);
+            {
+            sprintf( tbuff, "\033[?%dh", tracking_state);
+            PDC_puts_to_stdout( tbuff);
+            }
          curr_tracking_state = tracking_state;
          PDC_doupdate( );
          }
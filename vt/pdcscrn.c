@@ -7,6 +7,8 @@
 #include <unistd.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
 
 static struct termios orig_term;
 #endif
@@ -100,13 +102,27 @@ static int set_win10_for_vt_codes( const bool setting_mode)
 
 int PDC_rows = -1, PDC_cols = -1;
 bool PDC_resize_occurred = FALSE;
+bool PDC_probe_pending = FALSE;     /* probe replies may still turn up */
 const int STDIN = 0;
 chtype PDC_capabilities = 0;
 
 /* COLOR_PAIR to attribute encoding table. */
 
+#ifdef USE_TERMIOS
+static struct termios prog_term;
+static bool prog_term_set = FALSE;
+#endif
+
 void PDC_reset_prog_mode( void)
 {
+#ifdef USE_TERMIOS
+    if( prog_term_set)
+    {
+        tcsetattr( STDIN, TCSANOW, &prog_term);
+        PDC_start_reader( );
+        PDC_start_writer( );
+    }
+#endif
 }
 
 void PDC_reset_shell_mode( void)
@@ -124,7 +140,10 @@ int PDC_resize_screen(int nlines, int ncols)
       }
    else if( nlines > 1 && ncols > 1 && !PDC_is_ansi)
       {
-      printf( "\033[8;%d;%dt", nlines, ncols);
+      char tbuff[30];
+
+      sprintf( tbuff, "\033[8;%d;%dt", nlines, ncols);
+      PDC_puts_to_stdout( tbuff);
       PDC_rows = nlines;
       PDC_cols = ncols;
       }
@@ -141,15 +160,20 @@ void PDC_save_screen_mode(int i)
 
 void PDC_scr_close( void)
 {
-   if( !PDC_is_ansi)
-       printf( "\033[?1006l");    /* Turn off SGR mouse tracking */
-   printf( "\0338");         /* restore cursor & attribs (VT100) */
-   printf( "\033[m");         /* set default screen attributes */
-   printf( "\033[?47l");      /* restore screen */
+   PDC_stop_reader( );
+   if( PDC_vt_features & PDC_VT_SGR_MOUSE)
+       PDC_puts_to_stdout( "\033[?1006l");   /* Turn off SGR mouse tracking */
+   if( PDC_vt_features & PDC_VT_PASTE)
+       PDC_puts_to_stdout( "\033[?2004l");   /* Turn off bracketed paste */
+   PDC_puts_to_stdout( "\0338");        /* restore cursor & attribs (VT100) */
+   PDC_puts_to_stdout( "\033[m");       /* set default screen attributes */
+   PDC_puts_to_stdout( "\033[?47l");    /* restore screen */
    PDC_curs_set( 2);          /* blinking block cursor */
    PDC_gotoyx( PDC_cols - 1, 0);
    SP->_trap_mbe = 0;
    PDC_mouse_set( );          /* clear any mouse event captures */
+   PDC_set_nonblocking_output( FALSE);     /* and wait for output to finish */
+   PDC_stop_writer( );
 #ifdef _WIN32
    set_win10_for_vt_codes( FALSE);
 #else
@@ -196,7 +220,318 @@ static void sigintHandler( int sig)
 #define MAX_LINES 1000
 #define MAX_COLUMNS 1000
 
-bool PDC_has_rgb_color = FALSE;
+unsigned PDC_vt_features = 0;
+
+/* Features and attributes can be set with tokens in PDC_VT.  The probe
+cache file (see below) uses the same tokens.  */
+
+static const struct
+{
+    const char *token;
+    unsigned feature;
+    chtype attr;
+} vt_tokens[] = {
+    { "RGB",   PDC_VT_RGB,       0 },
+    { "SYNC",  PDC_VT_SYNC,      0 },
+    { "REP",   PDC_VT_REP,       0 },
+    { "SGR",   PDC_VT_SGR_MOUSE, 0 },
+    { "PASTE", PDC_VT_PASTE,     0 },
+    { "UND",   0,                A_UNDERLINE },
+    { "BLI",   0,                A_BLINK },
+    { "DIM",   0,                A_DIM },
+    { "STA",   0,                A_STANDOUT },
+    { NULL,    0,                0 } };
+
+static void _parse_vt_tokens( const char *text)
+{
+    int i;
+
+    for( i = 0; vt_tokens[i].token; i++)
+        if( strstr( text, vt_tokens[i].token))
+        {
+            PDC_vt_features |= vt_tokens[i].feature;
+            PDC_capabilities |= vt_tokens[i].attr;
+        }
+}
+
+/* Synchronized output (DEC private mode 2026) is ignored by terminals
+that lack it,  but we only turn it on for those known to support it
+(or if PDC_VT contains 'SYNC').  */
+
+static bool _supports_sync_update( const char *term_env)
+{
+    static const char *sync_terms[] = { "xterm-kitty", "foot", "contour",
+                                        "alacritty", "wezterm", NULL };
+    const char *term_program = getenv( "TERM_PROGRAM");
+    int i;
+
+    if( term_program && (!strcmp( term_program, "WezTerm")
+                      || !strcmp( term_program, "iTerm.app")))
+        return TRUE;
+    if( term_env)
+        for( i = 0; sync_terms[i]; i++)
+            if( !strncmp( term_env, sync_terms[i], strlen( sync_terms[i])))
+                return TRUE;
+    return FALSE;
+}
+
+#ifdef USE_TERMIOS
+
+/* Optional startup probe.  If PDC_VT contains 'PROBE',  we ask the terminal
+what it can do,  instead of guessing from TERM.  Terminals answer queries
+in the order received,  and ignore those they don't understand;  but every
+terminal answers DA1 (primary device attributes).  So DA1 is sent last,
+and we read replies until its answer shows up,  or until PROBE_TIMEOUT
+milliseconds have passed (in which case we give up and use the defaults).
+
+   The result is cached,  keyed on TERM and TERM_PROGRAM,  in
+$XDG_CACHE_HOME/pdcurses-vt (or ~/.cache/pdcurses-vt),  so that later
+startups skip the round trip.  Delete that file to force a new probe. */
+
+#define PROBE_TIMEOUT    200
+#define PROBE_BUFF_SIZE 1024
+#define CACHE_BUFF_SIZE 4096
+
+static const char *probe_queries =
+      "\033[?2026$p"            /* DECRQM : synchronized update */
+      "\033[?2004$p"            /* DECRQM : bracketed paste */
+      "\033[?1006$p"            /* DECRQM : SGR mouse */
+      "\033P+q524742\033\\"     /* XTGETTCAP : RGB */
+      "\033P+q5463\033\\"       /* XTGETTCAP : Tc */
+      "\033P+q726570\033\\"     /* XTGETTCAP : rep */
+      "\033[>0q"                /* XTVERSION */
+      "\033[>c"                 /* DA2 */
+      "\033[c";                 /* DA1 */
+
+      /* DA1 reply is CSI ? Ps ; Ps ... c.  Return a pointer to the first
+      parameter,  or NULL if it's not (yet) in the buffer.  */
+
+static const char *_find_da1_reply( const char *buff)
+{
+    const char *tptr = buff;
+
+    while( (tptr = strstr( tptr, "\033[?")) != NULL)
+    {
+        const char *params = tptr += 3;
+
+        while( (*tptr >= '0' && *tptr <= '9') || *tptr == ';')
+            tptr++;
+        if( *tptr == 'c')
+            return( params);
+    }
+    return( NULL);
+}
+
+static long _elapsed_ms( const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday( &now, NULL);
+    return( (now.tv_sec - start->tv_sec) * 1000L
+                  + (now.tv_usec - start->tv_usec) / 1000L);
+}
+
+static const char *_read_probe_replies( char *buff)
+{
+    struct timeval start;
+    const char *da1 = NULL;
+    int n_read = 0;
+
+    gettimeofday( &start, NULL);
+    *buff = '\0';
+    while( !da1 && n_read < PROBE_BUFF_SIZE - 1)
+    {
+        const long remaining = PROBE_TIMEOUT - _elapsed_ms( &start);
+        struct timeval tv;
+        fd_set rdset;
+        ssize_t bytes_read;
+
+        if( remaining <= 0)
+            break;
+        tv.tv_sec = 0;
+        tv.tv_usec = remaining * 1000L;
+        FD_ZERO( &rdset);
+        FD_SET( STDIN, &rdset);
+        if( select( STDIN + 1, &rdset, NULL, NULL, &tv) <= 0)
+            continue;
+        bytes_read = read( STDIN, buff + n_read,
+                                  PROBE_BUFF_SIZE - 1 - n_read);
+        if( bytes_read <= 0)
+            break;
+        n_read += (int)bytes_read;
+        buff[n_read] = '\0';
+        da1 = _find_da1_reply( buff);
+    }
+    return( da1);
+}
+
+      /* DECRQM reply is CSI ? Pd ; Ps $ y,  with Ps = 1 (set), 2 (reset),
+      3 (permanently set), 4 (permanently reset), 0 (not recognized). */
+
+static int _decrqm_reply( const char *buff, const int mode)
+{
+    char search[20];
+    const char *tptr;
+
+    sprintf( search, "\033[?%d;", mode);
+    tptr = strstr( buff, search);
+    return( tptr ? atoi( tptr + strlen( search)) : -1);
+}
+
+static bool _mode_supported( const char *buff, const int mode)
+{
+    const int rval = _decrqm_reply( buff, mode);
+
+    return( rval >= 1 && rval <= 3);
+}
+
+      /* XTGETTCAP reply is DCS 1 + r name=value ST for known capabilities,
+      DCS 0 + r ST otherwise.  Names are hex-encoded. */
+
+static bool _has_termcap( const char *buff, const char *hex_name)
+{
+    char search[20];
+
+    sprintf( search, "\033P1+r%s", hex_name);
+    return( strstr( buff, search) != NULL);
+}
+
+static bool _probe_terminal( void)
+{
+    struct termios orig, term;
+    char buff[PROBE_BUFF_SIZE];
+    const char *da1, *da2;
+
+    if( !isatty( STDIN) || !isatty( STDOUT_FILENO))
+        return( FALSE);
+    tcgetattr( STDIN, &orig);
+    memcpy( &term, &orig, sizeof( term));
+    term.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr( STDIN, TCSANOW, &term);
+    fflush( stdout);
+    if( write( STDOUT_FILENO, probe_queries, strlen( probe_queries)) > 0)
+    {
+        da1 = _read_probe_replies( buff);
+        PDC_probe_pending = !da1;   /* see decode_probe_reply( ) */
+    }
+    else
+        da1 = NULL;
+    tcsetattr( STDIN, TCSANOW, &orig);
+    if( !da1)
+        return( FALSE);
+
+    PDC_vt_features = 0;
+    PDC_capabilities = 0;
+    if( _mode_supported( buff, 2026))
+        PDC_vt_features |= PDC_VT_SYNC;
+    if( _mode_supported( buff, 2004))
+        PDC_vt_features |= PDC_VT_PASTE;
+            /* SGR mouse is assumed if the terminal can't answer DECRQM */
+    if( _mode_supported( buff, 1006) || (_decrqm_reply( buff, 1006) == -1
+                                   && _decrqm_reply( buff, 2026) == -1))
+        PDC_vt_features |= PDC_VT_SGR_MOUSE;
+    if( _has_termcap( buff, "524742") || _has_termcap( buff, "5463"))
+        PDC_vt_features |= PDC_VT_RGB;
+    da2 = strstr( buff, "\033[>");
+    if( _has_termcap( buff, "726570") || (da2 && atoi( da2 + 3) == 41))
+        PDC_vt_features |= PDC_VT_REP;        /* 41 = xterm */
+    if( atoi( da1) >= 62)         /* VT220 or later */
+        PDC_capabilities |= A_UNDERLINE | A_BLINK;
+    if( strstr( buff, "\033P>|"))       /* answered XTVERSION */
+        PDC_capabilities |= A_DIM;
+    return( TRUE);
+}
+
+static bool _probe_cache_path( char *path)
+{
+    const char *dir = getenv( "XDG_CACHE_HOME");
+
+    if( dir && *dir)
+        snprintf( path, FILENAME_MAX, "%s/pdcurses-vt", dir);
+    else if( (dir = getenv( "HOME")) != NULL)
+        snprintf( path, FILENAME_MAX, "%s/.cache/pdcurses-vt", dir);
+    else
+        return( FALSE);
+    return( TRUE);
+}
+
+static bool _is_cache_line_for( const char *line, const char *key)
+{
+    const size_t len = strlen( key);
+
+    return( !strncmp( line, key, len)
+                  && (line[len] == ' ' || line[len] == '\n'));
+}
+
+static bool _read_probe_cache( const char *path, const char *key)
+{
+    FILE *ifile = fopen( path, "r");
+    char line[200];
+    bool found = FALSE;
+
+    if( ifile)
+    {
+        while( !found && fgets( line, sizeof( line), ifile))
+            if( _is_cache_line_for( line, key))
+            {
+                PDC_vt_features = 0;
+                PDC_capabilities = 0;
+                _parse_vt_tokens( line + strlen( key));
+                found = TRUE;
+            }
+        fclose( ifile);
+    }
+    return( found);
+}
+
+static void _write_probe_cache( const char *path, const char *key)
+{
+    FILE *ifile = fopen( path, "r"), *ofile;
+    char buff[CACHE_BUFF_SIZE], line[200];
+    size_t len = 0;
+    int i;
+
+    if( ifile)       /* keep entries for other terminals */
+    {
+        while( fgets( line, sizeof( line), ifile))
+            if( !_is_cache_line_for( line, key)
+                       && len + strlen( line) < CACHE_BUFF_SIZE)
+            {
+                strcpy( buff + len, line);
+                len += strlen( line);
+            }
+        fclose( ifile);
+    }
+    ofile = fopen( path, "w");
+    if( ofile)
+    {
+        fwrite( buff, 1, len, ofile);
+        fprintf( ofile, "%s", key);
+        for( i = 0; vt_tokens[i].token; i++)
+            if( (PDC_vt_features & vt_tokens[i].feature)
+                        || (PDC_capabilities & vt_tokens[i].attr))
+                fprintf( ofile, " %s", vt_tokens[i].token);
+        fprintf( ofile, "\n");
+        fclose( ofile);
+    }
+}
+
+static void _probe_terminal_features( const char *term_env)
+{
+    const char *term_program = getenv( "TERM_PROGRAM");
+    char key[100], path[FILENAME_MAX];
+    const bool have_cache = _probe_cache_path( path);
+
+    snprintf( key, sizeof( key), "%s/%s", (term_env ? term_env : ""),
+                                  (term_program ? term_program : ""));
+    if( strchr( key, ' '))
+        *strchr( key, ' ') = '\0';
+    if( have_cache && _read_probe_cache( path, key))
+        return;
+    if( _probe_terminal( ) && have_cache)
+        _write_probe_cache( path, key);
+}
+#endif
 
 int PDC_scr_open(void)
 {
@@ -212,25 +547,26 @@ int PDC_scr_open(void)
 #endif
 
     PDC_LOG(("PDC_scr_open called\n"));
-    if( !strcmp( term_env, "linux"))
+    if( term_env && !strcmp( term_env, "linux"))
        PDC_is_ansi = TRUE;
-    else if( colorterm && !strcmp( colorterm, "truecolor"))
-       PDC_has_rgb_color = TRUE;
-    if( capabilities)      /* these should really come from terminfo! */
+    if( !PDC_is_ansi)
        {
-       if( strstr( capabilities, "RGB"))
-          PDC_has_rgb_color = TRUE;
-       if( strstr( capabilities, "UND"))
-          PDC_capabilities |= A_UNDERLINE;
-       if( strstr( capabilities, "BLI"))
-          PDC_capabilities |= A_BLINK;
-       if( strstr( capabilities, "DIM"))
-          PDC_capabilities |= A_DIM;
-       if( strstr( capabilities, "STA"))
-          PDC_capabilities |= A_STANDOUT;
+       PDC_vt_features |= PDC_VT_SGR_MOUSE | PDC_VT_PASTE;
+       if( _supports_sync_update( term_env))
+          PDC_vt_features |= PDC_VT_SYNC;
+#ifdef USE_TERMIOS
+       if( capabilities && strstr( capabilities, "PROBE"))
+          _probe_terminal_features( term_env);
+#endif
+       if( colorterm && !strcmp( colorterm, "truecolor"))
+          PDC_vt_features |= PDC_VT_RGB;
        }
+    if( capabilities)      /* these should really come from terminfo! */
+       _parse_vt_tokens( capabilities);
+    if( PDC_is_ansi)        /* only RGB makes sense in ANSI mode */
+       PDC_vt_features &= PDC_VT_RGB;
     COLORS = (PDC_is_ansi ? 16 : 256);
-    if( PDC_has_rgb_color)
+    if( PDC_vt_features & PDC_VT_RGB)
        COLORS = 256 + (256 * 256 * 256);
     assert( SP);
     if (!SP || PDC_init_palette( ))
@@ -271,6 +607,7 @@ int PDC_scr_open(void)
     SP->orig_attr = TRUE;
     SP->orig_fore = SP->orig_back = -1;
     SP->termattrs = PDC_capabilities & ~A_BLINK;
+    SP->check_typeahead = TRUE;        /* see typeahead( ) */
 
     while( PDC_get_rows( ) < 1 && PDC_get_columns( ) < 1)
       ;     /* wait for screen to be drawn and size determined */
@@ -300,12 +637,22 @@ int PDC_scr_open(void)
     tcgetattr( STDIN, &orig_term);
     memcpy( &term, &orig_term, sizeof( term));
     term.c_lflag &= ~(ICANON | ECHO);
+    term.c_cc[VMIN] = 0;        /* read( ) returns at once,  even if */
+    term.c_cc[VTIME] = 0;       /* there's nothing to be read */
     tcsetattr( STDIN, TCSANOW, &term);
+    memcpy( &prog_term, &term, sizeof( term));
+    prog_term_set = TRUE;
+    PDC_start_reader( );
+    PDC_start_writer( );
 #endif
-    if( !PDC_is_ansi)
-        printf( "\033[?1006h");    /* Set SGR mouse tracking,  if available */
-    printf( "\033[?47h");      /* Save screen */
-    printf( "\0337");         /* save cursor & attribs (VT100) */
+    if( PDC_vt_features & PDC_VT_SGR_MOUSE)
+        PDC_puts_to_stdout( "\033[?1006h");  /* Set SGR mouse tracking */
+    if( PDC_vt_features & PDC_VT_PASTE)
+        PDC_puts_to_stdout( "\033[?2004h");  /* Set bracketed paste */
+    PDC_puts_to_stdout( "\033[?47h");       /* Save screen */
+    PDC_puts_to_stdout( "\0337");          /* save cursor & attribs (VT100) */
+    if( capabilities && strstr( capabilities, "NONBLOCK"))
+        PDC_set_nonblocking_output( TRUE);
     PDC_resize_occurred = FALSE;
     PDC_LOG(("PDC_scr_open exit\n"));
 /*  PDC_reset_prog_mode();   doesn't do anything anyway */
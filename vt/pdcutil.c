@@ -5,6 +5,12 @@
 #else
    #include <unistd.h>
 #endif
+#if defined( DOS)
+   #include <time.h>
+#elif !defined( _WIN32)
+   #include <time.h>
+   #include <sys/time.h>
+#endif
 #include "curspriv.h"
 
 void PDC_beep(void)
@@ -22,6 +28,32 @@ void PDC_napms(int ms)
 #endif
 }
 
+   /* Milliseconds from some arbitrary starting point.  Only differences
+   between two values are meaningful.  Where it's available,  we use the
+   monotonic clock,  so that timeouts aren't thrown off if someone sets
+   the system clock while we're waiting.  The value may wrap around;
+   differences between nearby values are still correct.    */
+
+long PDC_millisecs( void)
+{
+#ifdef _WIN32
+    return( (long)GetTickCount( ));
+#elif defined( DOS)
+    return( (long)( clock( ) * 1000. / CLOCKS_PER_SEC));
+#elif defined( CLOCK_MONOTONIC)
+    struct timespec t;
+
+    clock_gettime( CLOCK_MONOTONIC, &t);
+    return( (long)( (unsigned long)t.tv_sec * 1000UL
+                  + (unsigned long)t.tv_nsec / 1000000UL));
+#else
+    struct timeval t;
+
+    gettimeofday( &t, NULL);
+    return( (long)( (unsigned long)t.tv_sec * 1000UL
+                  + (unsigned long)t.tv_usec / 1000UL));
+#endif
+}
 
 const char *PDC_sysname(void)
 {
@@ -8,6 +8,41 @@
     will actually work.  Happens in older Windows, DOS, Linux console. */
 extern int PDC_is_ansi;
 
+   /* Terminal features the output (and input) code may use.  These come
+    from TERM,  COLORTERM and PDC_VT,  or from the optional startup probe
+    (see PDC_VT=PROBE in README.md). */
+#define PDC_VT_RGB          0x01    /* 24-bit "true" color */
+#define PDC_VT_SYNC         0x02    /* synchronized update,  mode 2026 */
+#define PDC_VT_REP          0x04    /* REP,  repeat preceding character */
+#define PDC_VT_SGR_MOUSE    0x08    /* SGR mouse encoding,  mode 1006 */
+#define PDC_VT_PASTE        0x10    /* bracketed paste,  mode 2004 */
+
+extern unsigned PDC_vt_features;
+
+   /* Built with PDC_VT_THREADS (THREADS=Y),  input is read,  and output
+    written,  by threads of their own on Unixes;  see pdckbd.c and
+    pdcdisp.c.  They're stopped while the program is out of curses mode,
+    so as not to take input meant for others (or write over their output). */
+#if defined( PDC_VT_THREADS) && !defined( _WIN32) && !defined( DOS)
+   #define USE_READER_THREAD
+   #define USE_WRITER_THREAD
+void PDC_start_reader( void);                           /* pdckbd.c */
+void PDC_stop_reader( void);
+void PDC_wake_input( void);
+void PDC_start_writer( void);                           /* pdcdisp.c */
+void PDC_stop_writer( void);
+#else
+   #define PDC_start_reader( )
+   #define PDC_stop_reader( )
+   #define PDC_start_writer( )
+   #define PDC_stop_writer( )
+#endif
+
+void PDC_puts_to_stdout( const char *buff);              /* pdcdisp.c */
+void PDC_set_nonblocking_output( const bool on);
+bool PDC_output_pending( void);
+void PDC_drain_output( void);
+
 #ifdef PDC_WIDE
    #if !defined( UNICODE)
       # define UNICODE
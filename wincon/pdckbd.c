@@ -230,6 +230,32 @@ bool PDC_check_key(void)
     return (event_count != 0);
 }
 
+/* sleep until there's console input, or ms milliseconds pass (ms < 0:
+   forever); but wake up in time to blink text, if that's enabled */
+
+bool PDC_wait_for_input(int ms)
+{
+    DWORD timeout = (ms < 0) ? INFINITE : (DWORD)ms;
+
+    if (key_count > 0)
+        return TRUE;
+
+    if (SP->termattrs & A_BLINK)
+    {
+        DWORD since_blink = GetTickCount() - pdc_last_blink;
+
+        if (since_blink >= 500)
+        {
+            PDC_blink_text();
+            since_blink = 0;
+        }
+        if (timeout > 500 - since_blink)
+            timeout = 500 - since_blink;
+    }
+
+    return WaitForSingleObject(pdc_con_in, timeout) == WAIT_OBJECT_0;
+}
+
 /* _get_key_count returns 0 if save_ip doesn't contain an event which
    should be passed back to the user. This function filters "useless"
    events.
@@ -464,49 +490,16 @@ static int _process_mouse_event(void)
         return KEY_MOUSE;
     }
 
-    action = (MEV.dwEventFlags == 2) ? BUTTON_DOUBLE_CLICKED :
-            ((MEV.dwEventFlags == 1) ? BUTTON_MOVED : BUTTON_PRESSED);
+    /* A double click (dwEventFlags == 2) is reported as just another
+       press; the core makes clicks, double and triple clicks from the
+       presses and releases, so they're timed the same on every port */
+
+    action = (MEV.dwEventFlags == 1) ? BUTTON_MOVED : BUTTON_PRESSED;
 
     for (i = 0; i < 3; i++)
         SP->mouse_status.button[i] =
             (MEV.dwButtonState & button_mask[i]) ? action : 0;
 
-    if (action == BUTTON_PRESSED && MEV.dwButtonState & 7 && SP->mouse_wait)
-    {
-        /* Check for a click -- a PRESS followed immediately by a release */
-
-        if (!event_count)
-        {
-            napms(SP->mouse_wait);
-
-            GetNumberOfConsoleInputEvents(pdc_con_in, &event_count);
-        }
-
-        if (event_count)
-        {
-            INPUT_RECORD ip;
-            DWORD count;
-            bool have_click = FALSE;
-
-            PeekConsoleInput(pdc_con_in, &ip, 1, &count);
-
-            for (i = 0; i < 3; i++)
-            {
-                if (SP->mouse_status.button[i] == BUTTON_PRESSED &&
-                    !(ip.Event.MouseEvent.dwButtonState & button_mask[i]))
-                {
-                    SP->mouse_status.button[i] = BUTTON_CLICKED;
-                    have_click = TRUE;
-                }
-            }
-
-            /* If a click was found, throw out the event */
-
-            if (have_click)
-                ReadConsoleInput(pdc_con_in, &ip, 1, &count);
-        }
-    }
-
     SP->mouse_status.changes = 0;
 
     for (i = 0; i < 3; i++)
@@ -622,6 +615,13 @@ void PDC_flushinp(void)
     FlushConsoleInputBuffer(pdc_con_in);
 }
 
+/* console input comes from a handle, not a file descriptor */
+
+int PDC_get_input_fd(void)
+{
+    return -1;
+}
+
 bool PDC_has_mouse(void)
 {
     return TRUE;
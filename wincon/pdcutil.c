@@ -20,6 +20,11 @@ void PDC_napms(int ms)
     Sleep(ms);
 }
 
+long PDC_millisecs(void)
+{
+    return (long)GetTickCount();
+}
+
 const char *PDC_sysname(void)
 {
     return "Windows";
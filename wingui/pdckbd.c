@@ -14,6 +14,7 @@ void PDC_set_keyboard_binary(bool on)
 
 extern int PDC_key_queue_low, PDC_key_queue_high;
 extern int PDC_key_queue[KEY_QUEUE_SIZE];
+extern MOUSE_STATUS PDC_mouse_queue[KEY_QUEUE_SIZE];
 
 bool PDC_check_key(void)
 {
@@ -22,6 +23,25 @@ bool PDC_check_key(void)
     return FALSE;
 }
 
+/* sleep until the window thread queues a key, or ms milliseconds pass
+   (ms < 0: forever).  As in PDC_napms(),  the critical section is left
+   while we wait,  so the window thread can get at the queue. */
+
+bool PDC_wait_for_input(int ms)
+{
+    extern CRITICAL_SECTION PDC_cs;
+    extern HANDLE PDC_key_queue_event;
+    DWORD rval;
+
+    if( PDC_check_key( ))
+        return TRUE;
+    LeaveCriticalSection(&PDC_cs);
+    rval = WaitForSingleObject( PDC_key_queue_event,
+                                (ms < 0 ? INFINITE : (DWORD)ms));
+    EnterCriticalSection(&PDC_cs);
+    return( rval == WAIT_OBJECT_0);
+}
+
 /* return the next available key or mouse event */
 
 int PDC_get_key(void)
@@ -30,6 +50,8 @@ int PDC_get_key(void)
 
     if( PDC_key_queue_low != PDC_key_queue_high)
     {
+        if( PDC_key_queue[PDC_key_queue_low] == KEY_MOUSE)
+            SP->mouse_status = PDC_mouse_queue[PDC_key_queue_low];
         rval = PDC_key_queue[PDC_key_queue_low++];
         if( PDC_key_queue_low == KEY_QUEUE_SIZE)
             PDC_key_queue_low = 0;
@@ -55,6 +77,13 @@ void PDC_flushinp(void)
     PDC_key_queue_low = PDC_key_queue_high = 0;
 }
 
+/* input arrives as window messages; there's no file descriptor */
+
+int PDC_get_input_fd( void)
+{
+    return -1;
+}
+
 bool PDC_has_mouse( void)
 {
     return TRUE;
@@ -172,6 +172,11 @@ static int PDC_shutdown_key[PDC_MAX_FUNCTION_KEYS] = { 0, 22, CTL_EQUAL, CTL_MIN
 int PDC_n_rows, PDC_n_cols;
 int PDC_cxChar, PDC_cyChar, PDC_key_queue_low = 0, PDC_key_queue_high = 0;
 int PDC_key_queue[KEY_QUEUE_SIZE];
+MOUSE_STATUS PDC_mouse_queue[KEY_QUEUE_SIZE];
+
+   /* Set whenever a key is added to the queue,  so that the main thread */
+   /* can sleep in PDC_wait_for_input() until there's something to read. */
+HANDLE PDC_key_queue_event;
 
    /* If the following is true,  you can enter Unicode values by hitting */
    /* Alt and holding it down while typing the value of the character on */
@@ -231,6 +236,7 @@ static void add_key_to_queue( const int new_key)
     {
         PDC_key_queue[PDC_key_queue_high] = new_key;
         PDC_key_queue_high = new_idx;
+        SetEvent( PDC_key_queue_event);
     }
 }
 
@@ -524,38 +530,17 @@ HFONT PDC_get_font_handle( const int is_bold);            /* pdcdisp.c */
 
 /* Mouse handling is done as follows:
 
-   What we want is a setup wherein,  if the user presses and releases a
-mouse button within SP->mouse_wait milliseconds,  there will be a
-KEY_MOUSE issued through getch( ) and the "button state" for that button
-will be set to BUTTON_CLICKED.
-
-   If the user presses and releases the button,  and it takes _longer_
-than SP->mouse_wait milliseconds,  then there should be a KEY_MOUSE
-issued with the "button state" set to BUTTON_PRESSED.  Then,  later,
-another KEY_MOUSE with a BUTTON_RELEASED.
-
-   To accomplish this:  when a message such as WM_LBUTTONDOWN,
-WM_RBUTTONDOWN,  or WM_MBUTTONDOWN is issued (and more recently WM_XBUTTONDOWN
-for five-button mice),  we set up a timer with a period of SP->mouse_wait
-milliseconds.  There are then two possibilities. The user will release the
-button quickly (so it's a "click") or they won't (and it's a "press/release").
-
-   In the first case,  we'll get the WM_xBUTTONUP message before the
-WM_TIMER one.  We'll kill the timer and set up the BUTTON_CLICKED state. (*)
-
-   In the second case,  we'll get the WM_TIMER message first,  so we'll
-set the BUTTON_PRESSED state and kill the timer.  Eventually,  the user
-will get around to letting go of the mouse button,  and we'll get that
-WM_xBUTTONUP message.  At that time,  we'll set the BUTTON_RELEASED state
-and add the second KEY_MOUSE to the key queue.
-
-   Also,  note that if there is already a KEY_MOUSE to the queue,  there's
-no point in adding another one.  At least at present,  the actual mouse
-events aren't queued anyway.  So if there was,  say,  a click and then a
-release without getch( ) being called in between,  you'd then have two
-KEY_MOUSEs on the queue,  but would have lost all information about what
-the first one actually was.  Hence the code near the end of this function
-to ensure there isn't already a KEY_MOUSE in the queue.
+   Presses,  releases and moves are put in the key queue as KEY_MOUSEs as
+they come in,  each with its own MOUSE_STATUS in PDC_mouse_queue[] (at the
+same index as the KEY_MOUSE in PDC_key_queue[]).  PDC_get_key() copies
+that to SP->mouse_status when it takes the KEY_MOUSE out.  Clicks,  double
+and triple clicks are made from the presses and releases in the core (see
+PDC_mouse_event() in pdcurses/mouse.c),  so that it's all timed the same
+way on every platform.
+
+   Moves are a little different:  if there's already a KEY_MOUSE in the
+queue,  a move isn't added.  The program is already behind,  and will
+learn where the mouse has gone from the next move anyway.
 
    Also,  a note about wheel handling.  Pre-Vista,  you could just say
 "the wheel went up" or "the wheel went down".  Vista introduced the possibility
@@ -564,18 +549,7 @@ mouse move,  we add in the amount moved,  then check to see if that's
 enough to trigger a wheel up/down event (or possibly several).  The idea
 is that whereas before,  each movement would be 120 units (the default),
 you might now get a series of 40-unit moves and should emit a wheel up/down
-event on every third move.
-
-   (*) Things are actually slightly more complicated than this.  In general,
-it'll just be a plain old BUTTON_CLICKED state.  But if there was another
-BUTTON_CLICKED within the last 2 * SP->mouse_wait milliseconds,  then this
-must be a _double_ click,  so we set the BUTTON_DOUBLE_CLICKED state.  And
-if,  within that time frame,  there was a double or triple click,  then we
-set the BUTTON_TRIPLE_CLICKED state.  There isn't a "quad" or higher state,
-so if you quadruple-click the mouse,  with each click separated by less
-than 2 * SP->mouse_wait milliseconds,  then the messages sent will be
-BUTTON_CLICKED,  BUTTON_DOUBLE_CLICKED,  BUTTON_TRIPLE_CLICKED,  and
-then another BUTTON_TRIPLE_CLICKED.                                     */
+event on every third move.                                         */
 
 static bool mouse_key_already_in_queue( void)
 {
@@ -597,31 +571,28 @@ static int set_mouse( const int button_index, const int button_state,
                            const int x, const int y)
 {
     int n_key_mouse_to_add = 1;
+    MOUSE_STATUS status;
     POINT pt;
 
-                  /* If there is already a KEY_MOUSE in the queue,  we   */
-                  /* don't really want to add another one.  See above.   */
-    if( mouse_key_already_in_queue( ))
-        return( -1);
     pt.x = x;
     pt.y = y;
-    memset(&SP->mouse_status, 0, sizeof(MOUSE_STATUS));
+    memset(&status, 0, sizeof(MOUSE_STATUS));
     if( button_state == BUTTON_MOVED)
     {
         if( button_index < 0)
-            SP->mouse_status.changes = PDC_MOUSE_POSITION;
+            status.changes = PDC_MOUSE_POSITION;
          else
-            SP->mouse_status.changes = PDC_MOUSE_MOVED | (1 << button_index);
+            status.changes = PDC_MOUSE_MOVED | (1 << button_index);
     }
     else
     {
         if( button_index < PDC_MAX_MOUSE_BUTTONS)
         {
-            SP->mouse_status.button[button_index] = (short)button_state;
+            status.button[button_index] = (short)button_state;
             if( button_index < 3)
-               SP->mouse_status.changes = (1 << button_index);
+               status.changes = (1 << button_index);
             else
-               SP->mouse_status.changes = (0x40 << button_index);
+               status.changes = (0x40 << button_index);
         }
         else                      /* actually a wheel mouse movement */
         {                         /* button_state = number of units moved */
@@ -637,13 +608,13 @@ static int set_mouse( const int button_index, const int button_state,
                 {
                     n_key_mouse_to_add++;
                     mouse_wheel_vertical_loc -= mouse_wheel_sensitivity;
-                    SP->mouse_status.changes |= PDC_MOUSE_WHEEL_UP;
+                    status.changes |= PDC_MOUSE_WHEEL_UP;
                 }
                 while( mouse_wheel_vertical_loc < -mouse_wheel_sensitivity / 2)
                 {
                     n_key_mouse_to_add++;
                     mouse_wheel_vertical_loc += mouse_wheel_sensitivity;
-                    SP->mouse_status.changes |= PDC_MOUSE_WHEEL_DOWN;
+                    status.changes |= PDC_MOUSE_WHEEL_DOWN;
                 }
              }
              else       /* must be a horizontal event: */
@@ -653,19 +624,19 @@ static int set_mouse( const int button_index, const int button_state,
                 {
                     n_key_mouse_to_add++;
                     mouse_wheel_horizontal_loc -= mouse_wheel_sensitivity;
-                    SP->mouse_status.changes |= PDC_MOUSE_WHEEL_RIGHT;
+                    status.changes |= PDC_MOUSE_WHEEL_RIGHT;
                 }
                 while( mouse_wheel_horizontal_loc < -mouse_wheel_sensitivity / 2)
                 {
                     n_key_mouse_to_add++;
                     mouse_wheel_horizontal_loc += mouse_wheel_sensitivity;
-                    SP->mouse_status.changes |= PDC_MOUSE_WHEEL_LEFT;
+                    status.changes |= PDC_MOUSE_WHEEL_LEFT;
                 }
              }
         }
     }
-    SP->mouse_status.x = pt.x;
-    SP->mouse_status.y = pt.y;
+    status.x = pt.x;
+    status.y = pt.y;
     {
         int i, button_flags = 0;
 
@@ -679,17 +650,19 @@ static int set_mouse( const int button_index, const int button_state,
             button_flags |= PDC_BUTTON_CONTROL;
 
         for (i = 0; i < PDC_MAX_MOUSE_BUTTONS; i++)
-            SP->mouse_status.button[i] |= button_flags;
+            status.button[i] |= button_flags;
     }
                   /* If the window is maximized,  the click may occur just */
                   /* outside the "real" screen area.  If so,  we again     */
                   /* don't want to add a key to the queue:                 */
-    if( SP->mouse_status.x >= PDC_n_cols || SP->mouse_status.y >= PDC_n_rows)
+    if( status.x >= PDC_n_cols || status.y >= PDC_n_rows)
         n_key_mouse_to_add = 0;
-                  /* OK,  there isn't a KEY_MOUSE already in the queue.   */
-                  /* So we'll add one (or zero or more,  for wheel mice): */
+                  /* Add a KEY_MOUSE (or zero or more,  for wheel mice): */
     while( n_key_mouse_to_add--)
+    {
+        PDC_mouse_queue[PDC_key_queue_high] = status;
         add_key_to_queue( KEY_MOUSE);
+    }
     return( 0);
 }
 
@@ -1689,35 +1662,8 @@ INLINE void HandleMenuToggle( bool *ptr_ignore_resize)
     InvalidateRect( PDC_hWnd, NULL, FALSE);
 }
 
-INLINE uint64_t milliseconds_since_1970( void)
-{
-   FILETIME ft;
-   const uint64_t jd_1601 = 2305813;  /* actually 2305813.5 */
-   const uint64_t jd_1970 = 2440587;  /* actually 2440587.5 */
-   const uint64_t ten_million = 10000000;
-   const uint64_t diff = (jd_1970 - jd_1601) * ten_million * 86400;
-   uint64_t decimicroseconds_since_1970;   /* i.e.,  time in units of 1e-7 seconds */
-
-   GetSystemTimeAsFileTime( &ft);
-   decimicroseconds_since_1970 = ((uint64_t)ft.dwLowDateTime |
-                                ((uint64_t)ft.dwHighDateTime << 32)) - diff;
-   return( decimicroseconds_since_1970 / 10000);
-}
-
-typedef struct
-{
-   int x, y;
-   int button, action;
-} PDC_mouse_event;
-
 static int add_mouse( int button, const int action, const int x, const int y)
 {
-   static int n = 0;
-   static PDC_mouse_event e[10];
-   static uint64_t prev_t = 0;
-   const uint64_t curr_t = milliseconds_since_1970( );
-   const int timing_slop = 20;
-   bool within_timeout = (curr_t < prev_t + SP->mouse_wait + timing_slop);
    static int mouse_state = 0;
    static int prev_x, prev_y = -1;
    const bool actually_moved = (x != prev_x || y != prev_y);
@@ -1728,11 +1674,8 @@ static int add_mouse( int button, const int action, const int x, const int y)
        mouse_state |= (1 << button);
    else if( action == BUTTON_RELEASED)
        mouse_state &= ~(1 << button);
-   if( button >= 0)
-   {
-      prev_x = x;
-      prev_y = y;
-   }
+   prev_x = x;
+   prev_y = y;
    if( action == BUTTON_MOVED)
    {
        int i;
@@ -1759,56 +1702,13 @@ static int add_mouse( int button, const int action, const int x, const int y)
        if( !report_this_move)
            return( -1);
    }
-
-   if( !within_timeout || action == BUTTON_MOVED)
-       while( n && !set_mouse( e->button - 1, e->action, e->x, e->y))
-       {
-           n--;
-           memmove( e, e + 1, n * sizeof( PDC_mouse_event));
-       }
-   if( action == BUTTON_MOVED)
-       if( !set_mouse( button - 1, action, x, y))
-           return( n);
-   if( button < 0 && action != BUTTON_MOVED)
-       return( n);         /* we're just checking for timed-out events */
-   debug_printf( "Button %d, act %d, dt %ld : n %d\n", button, action,
-                  (long)( curr_t - prev_t), n);
-   e[n].button = button;
-   e[n].action = action;
-   e[n].x = x;
-   e[n].y = y;
-   if( n)
-   {
-       int merged_act = 0;
-
-       do
-       {
-           if( e[n - 1].button == e[n].button)
-           {
-               if( e[n - 1].action == BUTTON_PRESSED && e[n].action == BUTTON_RELEASED)
-                   merged_act = BUTTON_CLICKED;
-               else if( e[n - 1].action == BUTTON_CLICKED && e[n].action == BUTTON_CLICKED)
-                   merged_act = BUTTON_DOUBLE_CLICKED;
-               else if( e[n - 1].action == BUTTON_DOUBLE_CLICKED && e[n].action == BUTTON_CLICKED)
-                   merged_act = BUTTON_TRIPLE_CLICKED;
-               if( merged_act)
-               {
-                   n--;
-                   e[n].action = merged_act;
-               }
-           }
-       }  while( n && merged_act);
-   }
-   prev_t = curr_t;
-   n++;
-   return( n);
+   debug_printf( "Button %d, act %d\n", button, action);
+   return( set_mouse( button - 1, action, x, y));
 }
 
-/* Note that there are two types of WM_TIMER timer messages.  One type
-indicates that SP->mouse_wait milliseconds have elapsed since a mouse
-button was pressed;  that's handled as described in the above notes.
-The other type,  issued every half second,  indicates that blinking
-should take place.  For these,  HandleTimer() is called (see above).
+/* WM_TIMER messages with TIMER_ID_FOR_BLINKING,  issued every half
+second,  indicate that blinking should take place.  For these,
+HandleTimer() is called (see above).  Any other timer is just killed.
 
    On WM_PAINT,  we determine what parts of 'curscr' would be covered by
 the update rectangle,  and run those through PDC_transform_line.
@@ -1877,7 +1777,6 @@ static LRESULT ALIGN_STACK CALLBACK WndProc (const HWND hwnd,
         EnterCriticalSection(&PDC_cs);
         if( HandleMouseMove( wParam, lParam))
             modified_key_to_return = 0;
-        add_mouse( -1, -1, -1, -1);
         LeaveCriticalSection(&PDC_cs);
         return 0;
 
@@ -2003,7 +1902,6 @@ static LRESULT ALIGN_STACK CALLBACK WndProc (const HWND hwnd,
             /* blink the blinking text */
             HandleTimer( wParam );
         }
-        add_mouse( -1, -1, -1, -1);
         LeaveCriticalSection(&PDC_cs);
         return 0;
 
@@ -2345,6 +2243,7 @@ INLINE int set_up_window( void)
     }
 
     InitializeCriticalSection(&PDC_cs);
+    PDC_key_queue_event = CreateEvent(NULL, FALSE, FALSE, NULL);
     winthr_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
     winthr_h = (HANDLE) _beginthreadex(NULL, 0, window_thread, &winfo, 0, &winthr_id);
     if (winthr_h == (HANDLE) 0) {
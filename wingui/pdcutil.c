@@ -22,6 +22,11 @@ void PDC_napms(int ms)     /* 'ms' = milli,  _not_ microseconds! */
     EnterCriticalSection(&PDC_cs);
 }
 
+long PDC_millisecs(void)
+{
+    return (long)GetTickCount();
+}
+
 const char *PDC_sysname(void)
 {
    return "WinGUI";
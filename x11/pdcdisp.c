@@ -12,17 +12,335 @@
 
 #include "../common/acs_defs.h"
 
+#ifdef USE_XFT
+# include <stdint.h>
+# include "../common/pdccolor.h"
+
+# define FONT_ASCENT (pdc_xft_font ? pdc_xft_font->ascent : \
+                      pdc_app_data.normalFont->ascent)
+#else
+# define FONT_ASCENT (pdc_app_data.normalFont->ascent)
+#endif
+
 bool pdc_blinked_off;
 bool pdc_visible_cursor = FALSE;
 bool pdc_vertical_cursor = FALSE;
 
+/* Size of the per-line buffers; PDC_transform_line() handles up to
+   MAX_RUNS - 1 cells at once */
+
+#define MAX_RUNS 513
+
+/* The last state sent to the server for each GC, so that requests
+   which wouldn't change anything can be skipped. With a remote display,
+   every request saved is bandwidth saved. */
+
+typedef struct
+{
+    GC gc;
+    Pixel fore, back;
+    int function;
+    bool fore_set, back_set, function_set;
+    int nclip;
+    XRectangle clip[MAX_RUNS];
+} GCSTATE;
+
+static GCSTATE gc_state[4];
+
+/* Everything is drawn on pdc_backing, a pixmap the size of the window;
+   the area changed since the last copy is then copied to the window.
+   Exposes are answered from the pixmap as well, without redrawing any
+   text. */
+
+static int dirty_x1, dirty_y1, dirty_x2, dirty_y2;
+
+/* How a run of cells is drawn; runs in the same line with the same
+   style are drawn together */
+
+typedef struct
+{
+    GC gc;
+    Pixel fore, back;
+    bool blank;
+} STYLE;
+
+typedef struct
+{
+    chtype attr;
+    int start, len, col;
+    STYLE style;
+} RUN;
+
+/* The text of the line being drawn */
+
+#ifdef PDC_WIDE
+static XChar2b text[MAX_RUNS];
+#else
+static char text[MAX_RUNS];
+#endif
+
+#ifdef USE_XFT
+
+/* With Xft, the STYLE colors are RGB values from the common palette
+   code, and the text is kept as full code points. Xft uploads each
+   glyph to the server once, into a glyph set, and draws the runs with
+   XRender. Colors are allocated on first use and cached. */
+
+#define XFT_COLORS 64
+
+static FcChar32 text32[MAX_RUNS];
+
+static struct
+{
+    PACKED_RGB rgb;
+    bool valid;
+    XftColor color;
+} xft_colors[XFT_COLORS];
+
+static XRectangle xft_clip[MAX_RUNS];
+static int xft_nclip = -1;
+
+static XftColor *_xft_color(PACKED_RGB rgb)
+{
+    int i = (rgb ^ (rgb >> 8) ^ (rgb >> 16)) % XFT_COLORS;
+    Display *display = XCURSESDISPLAY;
+    int screen = DefaultScreen(display);
+
+    if (!xft_colors[i].valid || xft_colors[i].rgb != rgb)
+    {
+        XRenderColor rc;
+
+        if (xft_colors[i].valid)
+            XftColorFree(display, DefaultVisual(display, screen),
+                         DefaultColormap(display, screen),
+                         &xft_colors[i].color);
+
+        rc.red = (rgb & 0xff) * 0x101;
+        rc.green = ((rgb >> 8) & 0xff) * 0x101;
+        rc.blue = ((rgb >> 16) & 0xff) * 0x101;
+        rc.alpha = 0xffff;
+
+        xft_colors[i].valid = XftColorAllocValue(display,
+            DefaultVisual(display, screen), DefaultColormap(display, screen),
+            &rc, &xft_colors[i].color);
+        xft_colors[i].rgb = rgb;
+    }
+
+    return &xft_colors[i].color;
+}
+
+void PDC_free_xft_colors(void)
+{
+    Display *display = XCURSESDISPLAY;
+    int i, screen = DefaultScreen(display);
+
+    for (i = 0; i < XFT_COLORS; i++)
+        if (xft_colors[i].valid)
+        {
+            XftColorFree(display, DefaultVisual(display, screen),
+                         DefaultColormap(display, screen),
+                         &xft_colors[i].color);
+            xft_colors[i].valid = FALSE;
+        }
+
+    xft_nclip = -1;
+}
+
+static void _set_xft_clip(XRectangle *rects, int n)
+{
+    if (xft_nclip != n || memcmp(xft_clip, rects, n * sizeof(XRectangle)))
+    {
+        XftDrawSetClipRectangles(pdc_xft_draw, 0, 0, rects, n);
+        memcpy(xft_clip, rects, n * sizeof(XRectangle));
+        xft_nclip = n;
+    }
+}
+
+static XftFont *_xft_font(GC gc)
+{
+    if (gc == pdc_italic_gc && pdc_xft_italic)
+        return pdc_xft_italic;
+    if (gc == pdc_bold_gc && pdc_xft_bold)
+        return pdc_xft_bold;
+
+    return pdc_xft_font;
+}
+
+/* Draw all the runs in group[] with Xft; see _draw_runs() */
+
+static void _draw_xft_runs(RUN **group, XRectangle *bounds, int n)
+{
+    STYLE *style = &group[0]->style;
+    XftFont *font = _xft_font(style->gc);
+    XftColor *back = _xft_color(style->back);
+    int i;
+
+    _set_xft_clip(bounds, n);
+
+    for (i = 0; i < n; i++)
+        XftDrawRect(pdc_xft_draw, back, bounds[i].x, bounds[i].y,
+                    bounds[i].width, bounds[i].height);
+
+    if (style->blank)
+        return;
+
+    for (i = 0; i < n; i++)
+    {
+        RUN *run = group[i];
+        int xpos = bounds[i].x, ypos = bounds[i].y + pdc_fascent;
+        chtype attr = run->attr;
+        XftColor *fore = _xft_color(style->fore);
+
+        XftDrawString32(pdc_xft_draw, fore, font, xpos, ypos,
+                        text32 + run->start, run->len);
+
+        /* Underline, etc. */
+
+        if (attr & (A_LEFT | A_RIGHT | A_UNDERLINE))
+        {
+            int k;
+
+            if (SP->line_color != -1)
+                fore = _xft_color(PDC_get_palette_entry(SP->line_color));
+
+            if (attr & A_UNDERLINE)
+                XftDrawRect(pdc_xft_draw, fore, xpos, ypos + 1,
+                            pdc_fwidth * run->len, 1);
+
+            for (k = 0; k < run->len; k++)
+            {
+                int x = xpos + pdc_fwidth * k;
+
+                if (attr & A_LEFT)
+                    XftDrawRect(pdc_xft_draw, fore, x, bounds[i].y,
+                                1, pdc_fheight);
+
+                if (attr & A_RIGHT)
+                    XftDrawRect(pdc_xft_draw, fore, x + pdc_fwidth - 1,
+                                bounds[i].y, 1, pdc_fheight);
+            }
+        }
+    }
+}
+
+#endif /* USE_XFT */
+
+void PDC_reset_gc_state(void)
+{
+    memset(gc_state, 0, sizeof(gc_state));
+}
+
+static GCSTATE *_gc_state(GC gc)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        if (gc_state[i].gc == gc)
+            return gc_state + i;
+
+    /* new GC; take a free entry, or the last one if none are free */
+
+    for (i = 0; i < 3; i++)
+        if (!gc_state[i].gc)
+            break;
+
+    memset(gc_state + i, 0, sizeof(GCSTATE));
+    gc_state[i].gc = gc;
+
+    return gc_state + i;
+}
+
+static void _set_fore(GC gc, Pixel fore)
+{
+    GCSTATE *st = _gc_state(gc);
+
+    if (!st->fore_set || st->fore != fore)
+    {
+        XSetForeground(XCURSESDISPLAY, gc, fore);
+        st->fore = fore;
+        st->fore_set = TRUE;
+    }
+}
+
+static void _set_back(GC gc, Pixel back)
+{
+    GCSTATE *st = _gc_state(gc);
+
+    if (!st->back_set || st->back != back)
+    {
+        XSetBackground(XCURSESDISPLAY, gc, back);
+        st->back = back;
+        st->back_set = TRUE;
+    }
+}
+
+static void _set_function(GC gc, int function)
+{
+    GCSTATE *st = _gc_state(gc);
+
+    if (!st->function_set || st->function != function)
+    {
+        XSetFunction(XCURSESDISPLAY, gc, function);
+        st->function = function;
+        st->function_set = TRUE;
+    }
+}
+
+/* The rectangles must all lie in the same band, left to right */
+
+static void _set_clip(GC gc, XRectangle *rects, int n)
+{
+    GCSTATE *st = _gc_state(gc);
+
+    if (st->nclip != n || memcmp(st->clip, rects, n * sizeof(XRectangle)))
+    {
+        XSetClipRectangles(XCURSESDISPLAY, gc, 0, 0, rects, n, YXBanded);
+        memcpy(st->clip, rects, n * sizeof(XRectangle));
+        st->nclip = n;
+    }
+}
+
+static void _note_dirty(int x, int y, int width, int height)
+{
+    if (dirty_x2 <= dirty_x1 || dirty_y2 <= dirty_y1)
+    {
+        dirty_x1 = x;
+        dirty_y1 = y;
+        dirty_x2 = x + width;
+        dirty_y2 = y + height;
+    }
+    else
+    {
+        if (x < dirty_x1)
+            dirty_x1 = x;
+        if (y < dirty_y1)
+            dirty_y1 = y;
+        if (x + width > dirty_x2)
+            dirty_x2 = x + width;
+        if (y + height > dirty_y2)
+            dirty_y2 = y + height;
+    }
+}
+
+/* Copy the changed area of the backing pixmap to the window */
+
+void PDC_copy_backing(void)
+{
+    if (pdc_backing && dirty_x2 > dirty_x1 && dirty_y2 > dirty_y1)
+        XCopyArea(XCURSESDISPLAY, pdc_backing, XCURSESWIN, pdc_copy_gc,
+                  dirty_x1, dirty_y1, dirty_x2 - dirty_x1,
+                  dirty_y2 - dirty_y1, dirty_x1, dirty_y1);
+
+    dirty_x1 = dirty_y1 = dirty_x2 = dirty_y2 = 0;
+}
+
 /* Convert character positions x and y to pixel positions, stored in
    xpos and ypos */
 
 static void _make_xy(int x, int y, int *xpos, int *ypos)
 {
     *xpos = x * pdc_fwidth;
-    *ypos = pdc_app_data.normalFont->ascent + (y * pdc_fheight);
+    *ypos = FONT_ASCENT + (y * pdc_fheight);
 }
 
 static void _set_cursor_color(chtype *ch, int *fore, int *back)
@@ -67,7 +385,7 @@ static void _display_cursor(int old_row, int old_x, int new_row, int new_x)
        ignore the request */
 
     if (old_row >= SP->lines || old_x >= COLS ||
-        new_row >= SP->lines || new_x >= COLS)
+        new_row >= SP->lines || new_x >= COLS || !pdc_backing)
         return;
 
     /* display the character at the current cursor position */
@@ -83,18 +401,20 @@ static void _display_cursor(int old_row, int old_x, int new_row, int new_x)
         return;     /* cursor not displayed, no more to do */
 
     _make_xy(new_x, new_row, &xpos, &ypos);
+    _note_dirty(xpos, ypos - FONT_ASCENT,
+                pdc_fwidth, pdc_fheight);
 
     ch = curscr->_y[new_row] + new_x;
     _set_cursor_color(ch, &fore, &back);
 
     if (pdc_vertical_cursor)
     {
-        XSetForeground(XCURSESDISPLAY, pdc_cursor_gc, pdc_color[back]);
+        _set_fore(pdc_cursor_gc, PDC_color_pixel(back));
 
         for (i = 1; i <= SP->visibility; i++)
-            XDrawLine(XCURSESDISPLAY, XCURSESWIN, pdc_cursor_gc,
-                      xpos + i, ypos - pdc_app_data.normalFont->ascent,
-                      xpos + i, ypos - pdc_app_data.normalFont->ascent +
+            XDrawLine(XCURSESDISPLAY, pdc_backing, pdc_cursor_gc,
+                      xpos + i, ypos - FONT_ASCENT,
+                      xpos + i, ypos - FONT_ASCENT +
                       pdc_fheight - 1);
     }
     else
@@ -114,8 +434,8 @@ static void _display_cursor(int old_row, int old_x, int new_row, int new_x)
             yh = pdc_fheight / 4;
         }
 
-        XSetFunction(XCURSESDISPLAY, pdc_cursor_gc, GXinvert);
-        XFillRectangle(XCURSESDISPLAY, XCURSESWIN, pdc_cursor_gc,
+        _set_function(pdc_cursor_gc, GXinvert);
+        XFillRectangle(XCURSESDISPLAY, pdc_backing, pdc_cursor_gc,
             xpos, yp, pdc_fwidth, yh);
     }
 
@@ -158,6 +478,7 @@ void PDC_blink_text(XtPointer unused, XtIntervalId *id)
     }
 
     PDC_redraw_cursor();
+    PDC_copy_backing();
 
     if ((SP->termattrs & A_BLINK) || !pdc_blinked_off)
         XtAppAddTimeOut(pdc_app_context, pdc_app_data.textBlinkRate,
@@ -208,6 +529,8 @@ int PDC_display_cursor(int oldrow, int oldcol, int newrow, int newcol,
         _display_cursor(oldrow, oldcol, newrow, newcol);
     }
 
+    PDC_copy_backing();
+
     return OK;
 }
 
@@ -216,6 +539,7 @@ void PDC_blink_cursor(XtPointer unused, XtIntervalId *id)
     PDC_LOG(("PDC_blink_cursor() - called:\n"));
 
     _toggle_cursor();
+    PDC_copy_backing();
     XtAppAddTimeOut(pdc_app_context, pdc_app_data.cursorBlinkRate,
                     PDC_blink_cursor, NULL);
 }
@@ -229,21 +553,11 @@ void PDC_gotoyx(int row, int col)
     PDC_display_cursor(SP->cursrow, SP->curscol, row, col, SP->visibility);
 }
 
-/* update the given physical line to look like the corresponding line in
-   curscr */
+/* Work out the GC and colors for a run of cells with the given
+   attributes */
 
-/* Output a block of characters with common attributes */
-
-static int _new_packet(chtype attr, int len, int col, int row,
-#ifdef PDC_WIDE
-                       XChar2b *text)
-#else
-                       char *text)
-#endif
+static void _get_style(chtype attr, STYLE *style)
 {
-    XRectangle bounds;
-    GC gc;
-    int xpos, ypos;
     int fore, back;
     attr_t sysattrs;
     bool rev;
@@ -264,97 +578,187 @@ static int _new_packet(chtype attr, int len, int col, int row,
     /* Determine which GC to use - normal, italic or bold */
 
     if ((attr & A_ITALIC) && (sysattrs & A_ITALIC))
-        gc = pdc_italic_gc;
+        style->gc = pdc_italic_gc;
     else if ((attr & A_BOLD) && (sysattrs & A_BOLD))
-        gc = pdc_bold_gc;
+        style->gc = pdc_bold_gc;
     else
-        gc = pdc_normal_gc;
+        style->gc = pdc_normal_gc;
+
+#ifdef USE_XFT
+    if (pdc_xft_font)
+    {
+        PACKED_RGB rgb_fore, rgb_back;
+
+        PDC_get_rgb_values(attr, &rgb_fore, &rgb_back);
+
+        style->fore = rgb_fore;
+        style->back = rgb_back;
+    }
+    else
+#endif
+    {
+        style->fore = PDC_color_pixel(rev ? back : fore);
+        style->back = PDC_color_pixel(rev ? fore : back);
+    }
+
+    /* Blinking text in its "off" phase is just a block of the
+       background color */
+
+    style->blank = pdc_blinked_off && (sysattrs & A_BLINK) &&
+                   (attr & A_BLINK);
+}
+
+/* Output all the runs in a line which share the style of runs[first].
+   The GC is clipped to the runs' cells, so glyphs can't spill over
+   into their neighbors. */
 
-    _make_xy(col, row, &xpos, &ypos);
+static void _draw_runs(RUN *runs, bool *done, int first, int nruns,
+                       int row)
+{
+    XRectangle bounds[MAX_RUNS];
+    XSegment segs[3 * MAX_RUNS];
+    RUN *group[MAX_RUNS];
+    STYLE *style = &runs[first].style;
+    GC gc = style->gc;
+    int i, n = 0, nsegs = 0;
+
+    for (i = first; i < nruns; i++)
+    {
+        STYLE *st = &runs[i].style;
+
+        if (!done[i] && st->gc == gc && st->fore == style->fore &&
+            st->back == style->back && st->blank == style->blank)
+        {
+            int xpos, ypos;
 
-    bounds.x = xpos;
-    bounds.y = ypos - pdc_fascent;
-    bounds.width = pdc_fwidth * len;
-    bounds.height = pdc_fheight;
+            _make_xy(runs[i].col, row, &xpos, &ypos);
 
-    XSetClipRectangles(XCURSESDISPLAY, gc, 0, 0, &bounds, 1, Unsorted);
+            bounds[n].x = xpos;
+            bounds[n].y = ypos - pdc_fascent;
+            bounds[n].width = pdc_fwidth * runs[i].len;
+            bounds[n].height = pdc_fheight;
+
+            group[n++] = runs + i;
+            done[i] = TRUE;
+        }
+    }
 
-    if (pdc_blinked_off && (sysattrs & A_BLINK) && (attr & A_BLINK))
+#ifdef USE_XFT
+    if (pdc_xft_font)
     {
-        XSetForeground(XCURSESDISPLAY, gc, pdc_color[rev ? fore : back]);
-        XFillRectangle(XCURSESDISPLAY, XCURSESWIN, gc, xpos, bounds.y,
-                       bounds.width, pdc_fheight);
+        _draw_xft_runs(group, bounds, n);
+        return;
     }
-    else
+#endif
+
+    _set_clip(gc, bounds, n);
+
+    if (style->blank)
     {
-        /* Draw it */
+        _set_fore(gc, style->back);
+        XFillRectangles(XCURSESDISPLAY, pdc_backing, gc, bounds, n);
+        return;
+    }
+
+    /* Draw it */
+
+    _set_fore(gc, style->fore);
+    _set_back(gc, style->back);
 
-        XSetForeground(XCURSESDISPLAY, gc, pdc_color[rev ? back : fore]);
-        XSetBackground(XCURSESDISPLAY, gc, pdc_color[rev ? fore : back]);
+    for (i = 0; i < n; i++)
+    {
+        RUN *run = group[i];
+        int xpos = bounds[i].x, ypos = bounds[i].y + pdc_fascent;
+        chtype attr = run->attr;
 
 #ifdef PDC_WIDE
         XDrawImageString16(
 #else
         XDrawImageString(
 #endif
-            XCURSESDISPLAY, XCURSESWIN, gc, xpos, ypos, text, len);
+            XCURSESDISPLAY, pdc_backing, gc, xpos, ypos,
+            text + run->start, run->len);
 
-        /* Underline, etc. */
+        /* Underline, etc. -- collected for a single request */
 
-        if (attr & (A_LEFT | A_RIGHT | A_UNDERLINE))
+        if (attr & A_UNDERLINE)
         {
-            int k;
+            segs[nsegs].x1 = xpos;
+            segs[nsegs].x2 = xpos + pdc_fwidth * run->len;
+            segs[nsegs].y1 = segs[nsegs].y2 = ypos + 1;
+            nsegs++;
+        }
 
-            if (SP->line_color != -1)
-                XSetForeground(XCURSESDISPLAY, gc, pdc_color[SP->line_color]);
+        if (attr & (A_LEFT | A_RIGHT))
+        {
+            int k;
 
-            if (attr & A_UNDERLINE)
-                XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                          xpos, ypos + 1, xpos + pdc_fwidth * len, ypos + 1);
+            for (k = 0; k < run->len; k++)
+            {
+                int x = xpos + pdc_fwidth * k;
 
-            if (attr & A_LEFT)
-                for (k = 0; k < len; k++)
+                if (attr & A_LEFT)
                 {
-                    int x = xpos + pdc_fwidth * k;
-                    XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                              x, ypos - pdc_fascent, x, ypos + pdc_fdescent);
+                    segs[nsegs].x1 = segs[nsegs].x2 = x;
+                    segs[nsegs].y1 = ypos - pdc_fascent;
+                    segs[nsegs].y2 = ypos + pdc_fdescent;
+                    nsegs++;
                 }
 
-            if (attr & A_RIGHT)
-                for (k = 0; k < len; k++)
+                if (attr & A_RIGHT)
                 {
-                    int x = xpos + pdc_fwidth * (k + 1) - 1;
-                    XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                              x, ypos - pdc_fascent, x, ypos + pdc_fdescent);
+                    segs[nsegs].x1 = segs[nsegs].x2 = x + pdc_fwidth - 1;
+                    segs[nsegs].y1 = ypos - pdc_fascent;
+                    segs[nsegs].y2 = ypos + pdc_fdescent;
+                    nsegs++;
                 }
+            }
         }
     }
 
-    PDC_LOG(("_new_packet() - row: %d col: %d "
-             "num_cols: %d fore: %d back: %d text:<%s>\n",
-             row, col, len, fore, back, text));
+    if (nsegs)
+    {
+        if (SP->line_color != -1)
+            _set_fore(gc, PDC_color_pixel(SP->line_color));
 
-    return OK;
+        XDrawSegments(XCURSESDISPLAY, pdc_backing, gc, segs, nsegs);
+    }
+
+    PDC_LOG(("_draw_runs() - row: %d runs: %d fore: %lu back: %lu\n",
+             row, n, style->fore, style->back));
 }
 
 /* The core display routine -- update one line of text */
 
 void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 {
-#ifdef PDC_WIDE
-    XChar2b text[513];
-#else
-    char text[513];
-#endif
+    RUN runs[MAX_RUNS];
+    bool done[MAX_RUNS];
     chtype old_attr, attr;
-    int i, j;
+    int i, j, xpos, ypos, nruns = 0;
 
     PDC_LOG(("PDC_transform_line() - called: lineno: %d x: %d "
              "len: %d\n", lineno, x, len));
 
-    if (!len)
+    if (!len || !pdc_backing)
         return;
 
+    /* the buffers hold MAX_RUNS - 1 cells (and so at most that many
+       runs); longer lines, on very wide screens, go in pieces */
+
+    if (len > MAX_RUNS - 1)
+    {
+        PDC_transform_line(lineno, x, MAX_RUNS - 1, srcp);
+        PDC_transform_line(lineno, x + MAX_RUNS - 1, len - (MAX_RUNS - 1),
+                           srcp + MAX_RUNS - 1);
+        return;
+    }
+
+    _make_xy(x, lineno, &xpos, &ypos);
+    _note_dirty(xpos, ypos - pdc_fascent, pdc_fwidth * len, pdc_fheight);
+
+    /* Split the line into runs of cells with common attributes */
+
     old_attr = *srcp & A_ATTRIBUTES;
 
     for (i = 0, j = 0; j < len; j++)
@@ -380,26 +784,53 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 #endif
         if (attr != old_attr)
         {
-            if (_new_packet(old_attr, i, x, lineno, text) == ERR)
-                return;
+            runs[nruns].attr = old_attr;
+            runs[nruns].start = i;
+            runs[nruns++].col = x + i;
 
             old_attr = attr;
-            x += i;
-            i = 0;
+            i = j;
         }
 
 #ifdef PDC_WIDE
-        text[i].byte1 = (curr & 0xff00) >> 8;
-        text[i++].byte2 = curr & 0x00ff;
+        text[j].byte1 = (curr & 0xff00) >> 8;
+        text[j].byte2 = curr & 0x00ff;
 #else
-        text[i++] = curr & 0xff;
+        text[j] = curr & 0xff;
 #endif
+#ifdef USE_XFT
+        text32[j] = curr & A_CHARTEXT;
+#endif
+    }
+
+    runs[nruns].attr = old_attr;
+    runs[nruns].start = i;
+    runs[nruns++].col = x + i;
+
+    for (i = 0; i < nruns; i++)
+    {
+        runs[i].len = (i + 1 < nruns ? runs[i + 1].start : len) -
+                      runs[i].start;
+        _get_style(runs[i].attr, &runs[i].style);
+        done[i] = FALSE;
     }
 
-    _new_packet(old_attr, i, x, lineno, text);
+    /* Then draw them, one batch per distinct style */
+
+    for (i = 0; i < nruns; i++)
+        if (!done[i])
+            _draw_runs(runs, done, i, nruns, lineno);
 }
 
+/* Send any buffered requests to the server. Waiting for the server to
+   process them costs a round trip, which is only done on request. */
+
 void PDC_doupdate(void)
 {
-    XSync(XtDisplay(pdc_toplevel), False);
+    PDC_copy_backing();
+
+    if (pdc_app_data.syncUpdates)
+        XSync(XtDisplay(pdc_toplevel), False);
+    else
+        XFlush(XtDisplay(pdc_toplevel));
 }
@@ -390,22 +390,9 @@ static unsigned long _process_mouse_event( const XEvent *event)
 
         MOUSE_LOG(("\nButtonPress\n"));
 
-        SP->mouse_status.button[button_no - 1] = BUTTON_PRESSED;
-
-        napms(SP->mouse_wait);
-        while (XtAppPending(pdc_app_context))
-        {
-            XEvent rel;
-            XtAppNextEvent(pdc_app_context, &rel);
-
-            if (rel.type == ButtonRelease && rel.xbutton.button == button_no)
-                SP->mouse_status.button[button_no - 1] = BUTTON_CLICKED;
-            else
-                XSendEvent(XtDisplay(pdc_toplevel),
-                           RootWindowOfScreen(XtScreen(pdc_toplevel)),
-                           True, 0, &rel);
-        }
+        /* clicks are made from the press and release in the core */
 
+        SP->mouse_status.button[button_no - 1] = BUTTON_PRESSED;
         break;
 
     case MotionNotify:
@@ -470,6 +457,60 @@ bool PDC_check_key(void)
     return pdc_resize_now || !!s;
 }
 
+/* Sleep until an X event arrives, or ms milliseconds pass (ms < 0:
+   forever). The X connection is registered as an Xt input source for
+   the duration, so XtAppProcessEvent() wakes on it as well as on Xt
+   timers (text and cursor blinking, and our own timeout), without
+   taking any X event out of the queue. */
+
+static void _input_ready(XtPointer client_data, int *fid, XtInputId *id)
+{
+    *(bool *)client_data = TRUE;
+}
+
+static void _wait_over(XtPointer client_data, XtIntervalId *id)
+{
+    *(bool *)client_data = TRUE;
+}
+
+bool PDC_wait_for_input(int ms)
+{
+    Display *display = XtDisplay(pdc_toplevel);
+    XtInputId input_id;
+    XtIntervalId timer_id = 0;
+    bool ready = FALSE, timed_out = FALSE;
+
+    PDC_LOG(("PDC_wait_for_input() - called: ms=%d\n", ms));
+
+    XFlush(display);
+
+    input_id = XtAppAddInput(pdc_app_context, ConnectionNumber(display),
+                             (XtPointer)XtInputReadMask, _input_ready,
+                             &ready);
+    if (ms >= 0)
+        timer_id = XtAppAddTimeOut(pdc_app_context, (unsigned long)ms,
+                                   _wait_over, &timed_out);
+
+    while (!ready && !timed_out && !pdc_resize_now &&
+           !(XtAppPending(pdc_app_context) & XtIMXEvent))
+        XtAppProcessEvent(pdc_app_context, XtIMTimer | XtIMAlternateInput);
+
+    if (timer_id && !timed_out)
+        XtRemoveTimeOut(timer_id);
+    XtRemoveInput(input_id);
+
+    return !timed_out;
+}
+
+/* the X server connection, for an event loop to watch */
+
+int PDC_get_input_fd(void)
+{
+    PDC_LOG(("PDC_get_input_fd() - called\n"));
+
+    return ConnectionNumber(XtDisplay(pdc_toplevel));
+}
+
 /* return the next available key or mouse event */
 
 int PDC_get_key(void)
@@ -16,6 +16,10 @@ static int PDC_shutdown_key[PDC_MAX_FUNCTION_KEYS] = { 0, 0, 0, 0, 0 };
 #include "../common/icon64.xpm"
 #include "../common/icon32.xpm"
 
+#include <stdint.h>
+#include "../common/pdccolor.h"
+#include "../common/pdccolor.c"
+
 #ifdef PDC_WIDE
 # define DEFNFONT "-misc-fixed-medium-r-normal--20-200-75-75-c-100-iso10646-1"
 # define DEFIFONT "-misc-fixed-medium-o-normal--20-200-75-75-c-100-iso10646-1"
@@ -108,7 +112,11 @@ static XtResource app_resources[] =
     RINT(cursorBlinkRate, CursorBlinkRate, 0),
 
     RSTRING(textCursor, TextCursor),
-    RINT(textBlinkRate, TextBlinkRate, 500)
+    RINT(textBlinkRate, TextBlinkRate, 500),
+    RINT(syncUpdates, SyncUpdates, 0),
+#ifdef USE_XFT
+    RSTRINGP(xftFont, XftFont, "monospace-12"),
+#endif
 };
 
 #undef RCURSOR
@@ -134,6 +142,10 @@ static XrmOptionDescRec options[] =
     COPT(clickPeriod), COPT(doubleClickPeriod), COPT(scrollbarWidth),
     COPT(pointerForeColor), COPT(pointerBackColor),
     COPT(cursorBlinkRate), COPT(textCursor), COPT(textBlinkRate),
+    COPT(syncUpdates),
+#ifdef USE_XFT
+    COPT(xftFont),
+#endif
 
     CCOLOR(Black), CCOLOR(Red), CCOLOR(Green), CCOLOR(Yellow),
     CCOLOR(Blue), CCOLOR(Magenta), CCOLOR(Cyan), CCOLOR(White),
@@ -146,13 +158,18 @@ static XrmOptionDescRec options[] =
 #undef CCOLOR
 #undef COPT
 
-Pixel pdc_color[PDC_MAXCOL];
-
 XCursesAppData pdc_app_data;
 XtAppContext pdc_app_context;
 Widget pdc_toplevel, pdc_drawing;
 
 GC pdc_normal_gc, pdc_cursor_gc, pdc_italic_gc, pdc_bold_gc;
+GC pdc_copy_gc;
+Pixmap pdc_backing;
+
+#ifdef USE_XFT
+XftFont *pdc_xft_font, *pdc_xft_italic, *pdc_xft_bold;
+XftDraw *pdc_xft_draw;
+#endif
 int pdc_fheight, pdc_fwidth, pdc_fascent, pdc_fdescent;
 int pdc_wwidth, pdc_wheight;
 bool pdc_window_entered = TRUE, pdc_resize_now = FALSE;
@@ -169,6 +186,113 @@ static char *prog_name[] = {"PDCurses", NULL};
 static char **argv = prog_name;
 static int argc = 1;
 
+/* Pixel values for RGB colors. On TrueColor visuals (nearly all of
+   them now), these are computed from the visual's channel masks, with
+   no server request. Otherwise, colors are allocated from the default
+   colormap as needed, and the results kept in a small cache. */
+
+#define PIXEL_CACHE 256
+
+static bool true_color = FALSE;
+static int red_shift, green_shift, blue_shift;
+static unsigned long red_max, green_max, blue_max;
+
+static struct
+{
+    PACKED_RGB rgb;
+    Pixel pixel;
+    bool valid, allocated;
+} pixel_cache[PIXEL_CACHE];
+
+static void _get_channel(unsigned long mask, int *shift, unsigned long *max)
+{
+    for (*shift = 0; mask && !(mask & 1); mask >>= 1)
+        (*shift)++;
+
+    *max = mask;
+}
+
+static void _get_visual(void)
+{
+    Visual *visual = DefaultVisual(XCURSESDISPLAY,
+                                   DefaultScreen(XCURSESDISPLAY));
+
+#if defined(__cplusplus) || defined(c_plusplus)
+    true_color = (visual->c_class == TrueColor);
+#else
+    true_color = (visual->class == TrueColor);
+#endif
+
+    if (true_color)
+    {
+        _get_channel(visual->red_mask, &red_shift, &red_max);
+        _get_channel(visual->green_mask, &green_shift, &green_max);
+        _get_channel(visual->blue_mask, &blue_shift, &blue_max);
+    }
+}
+
+static void _free_pixels(void)
+{
+    Colormap cmap = DefaultColormap(XCURSESDISPLAY,
+                                    DefaultScreen(XCURSESDISPLAY));
+    int i;
+
+    for (i = 0; i < PIXEL_CACHE; i++)
+        if (pixel_cache[i].allocated)
+            XFreeColors(XCURSESDISPLAY, cmap, &pixel_cache[i].pixel, 1, 0);
+
+    memset(pixel_cache, 0, sizeof(pixel_cache));
+}
+
+static Pixel _rgb_pixel(PACKED_RGB rgb)
+{
+    unsigned long red = rgb & 0xff, green = (rgb >> 8) & 0xff,
+                  blue = (rgb >> 16) & 0xff;
+    int i;
+
+    if (true_color)
+        return (((red * red_max + 127) / 255) << red_shift) |
+               (((green * green_max + 127) / 255) << green_shift) |
+               (((blue * blue_max + 127) / 255) << blue_shift);
+
+    i = (rgb ^ (rgb >> 8) ^ (rgb >> 16)) % PIXEL_CACHE;
+
+    if (!pixel_cache[i].valid || pixel_cache[i].rgb != rgb)
+    {
+        Colormap cmap = DefaultColormap(XCURSESDISPLAY,
+                                        DefaultScreen(XCURSESDISPLAY));
+        XColor tmp;
+
+        if (pixel_cache[i].allocated)
+            XFreeColors(XCURSESDISPLAY, cmap, &pixel_cache[i].pixel, 1, 0);
+
+        tmp.red = red * 0x101;
+        tmp.green = green * 0x101;
+        tmp.blue = blue * 0x101;
+
+        /* if the colormap is full, settle for black or white */
+
+        pixel_cache[i].allocated = !!XAllocColor(XCURSESDISPLAY, cmap, &tmp);
+
+        if (pixel_cache[i].allocated)
+            pixel_cache[i].pixel = tmp.pixel;
+        else
+            pixel_cache[i].pixel = (red + green + blue > 381) ?
+                WhitePixel(XCURSESDISPLAY, DefaultScreen(XCURSESDISPLAY)) :
+                BlackPixel(XCURSESDISPLAY, DefaultScreen(XCURSESDISPLAY));
+
+        pixel_cache[i].rgb = rgb;
+        pixel_cache[i].valid = TRUE;
+    }
+
+    return pixel_cache[i].pixel;
+}
+
+Pixel PDC_color_pixel(int color)
+{
+    return _rgb_pixel(PDC_get_palette_entry(color));
+}
+
 /* close the physical screen */
 
 void PDC_scr_close(void)
@@ -209,6 +333,36 @@ void PDC_scr_free(void)
         XFreeGC(XCURSESDISPLAY, pdc_cursor_gc);
         pdc_cursor_gc = 0;
     }
+    if( pdc_copy_gc)
+    {
+        XFreeGC(XCURSESDISPLAY, pdc_copy_gc);
+        pdc_copy_gc = 0;
+    }
+#ifdef USE_XFT
+    if( pdc_xft_draw)
+    {
+        XftDrawDestroy(pdc_xft_draw);
+        pdc_xft_draw = NULL;
+    }
+    if( pdc_xft_font)
+    {
+        PDC_free_xft_colors();
+        if( pdc_xft_italic)
+            XftFontClose(XCURSESDISPLAY, pdc_xft_italic);
+        if( pdc_xft_bold)
+            XftFontClose(XCURSESDISPLAY, pdc_xft_bold);
+        XftFontClose(XCURSESDISPLAY, pdc_xft_font);
+        pdc_xft_font = pdc_xft_italic = pdc_xft_bold = NULL;
+    }
+#endif
+    _free_pixels();
+    PDC_free_palette();
+    if( pdc_backing)
+    {
+        XFreePixmap(XCURSESDISPLAY, pdc_backing);
+        pdc_backing = 0;
+    }
+    PDC_reset_gc_state();
     if( pdc_xic)
     {
         XDestroyIC(pdc_xic);
@@ -221,45 +375,39 @@ void XCursesExit(void)
     PDC_scr_free();
 }
 
+/* All colors come from the common palette; the first 16 entries are
+   seeded from the color resources, the rest are the xterm 256-color
+   defaults, then direct RGB values */
+
 static void _initialize_colors(void)
 {
-    int i, r, g, b;
-
-    pdc_color[COLOR_BLACK]   = pdc_app_data.colorBlack;
-    pdc_color[COLOR_RED]     = pdc_app_data.colorRed;
-    pdc_color[COLOR_GREEN]   = pdc_app_data.colorGreen;
-    pdc_color[COLOR_YELLOW]  = pdc_app_data.colorYellow;
-    pdc_color[COLOR_BLUE]    = pdc_app_data.colorBlue;
-    pdc_color[COLOR_MAGENTA] = pdc_app_data.colorMagenta;
-    pdc_color[COLOR_CYAN]    = pdc_app_data.colorCyan;
-    pdc_color[COLOR_WHITE]   = pdc_app_data.colorWhite;
-
-    pdc_color[COLOR_BLACK + 8]   = pdc_app_data.colorBoldBlack;
-    pdc_color[COLOR_RED + 8]     = pdc_app_data.colorBoldRed;
-    pdc_color[COLOR_GREEN + 8]   = pdc_app_data.colorBoldGreen;
-    pdc_color[COLOR_YELLOW + 8]  = pdc_app_data.colorBoldYellow;
-    pdc_color[COLOR_BLUE + 8]    = pdc_app_data.colorBoldBlue;
-    pdc_color[COLOR_MAGENTA + 8] = pdc_app_data.colorBoldMagenta;
-    pdc_color[COLOR_CYAN + 8]    = pdc_app_data.colorBoldCyan;
-    pdc_color[COLOR_WHITE + 8]   = pdc_app_data.colorBoldWhite;
-
-#define RGB(R, G, B) ( ((unsigned long)(R) << 16) | \
-                       ((unsigned long)(G) << 8) | \
-                       ((unsigned long)(B)) )
-
-    /* 256-color xterm extended palette: 216 colors in a 6x6x6 color
-       cube, plus 24 shades of gray */
-
-    for (i = 16, r = 0; r < 6; r++)
-        for (g = 0; g < 6; g++)
-            for (b = 0; b < 6; b++)
-                pdc_color[i++] = RGB(r ? r * 40 + 55 : 0,
-                                     g ? g * 40 + 55 : 0,
-                                     b ? b * 40 + 55 : 0);
-    for (i = 0; i < 24; i++)
-        pdc_color[i + 232] = RGB(i * 10 + 8, i * 10 + 8, i * 10 + 8);
-
-#undef RGB
+    XColor tmp[16];
+    int i;
+
+    tmp[COLOR_BLACK].pixel   = pdc_app_data.colorBlack;
+    tmp[COLOR_RED].pixel     = pdc_app_data.colorRed;
+    tmp[COLOR_GREEN].pixel   = pdc_app_data.colorGreen;
+    tmp[COLOR_YELLOW].pixel  = pdc_app_data.colorYellow;
+    tmp[COLOR_BLUE].pixel    = pdc_app_data.colorBlue;
+    tmp[COLOR_MAGENTA].pixel = pdc_app_data.colorMagenta;
+    tmp[COLOR_CYAN].pixel    = pdc_app_data.colorCyan;
+    tmp[COLOR_WHITE].pixel   = pdc_app_data.colorWhite;
+
+    tmp[COLOR_BLACK + 8].pixel   = pdc_app_data.colorBoldBlack;
+    tmp[COLOR_RED + 8].pixel     = pdc_app_data.colorBoldRed;
+    tmp[COLOR_GREEN + 8].pixel   = pdc_app_data.colorBoldGreen;
+    tmp[COLOR_YELLOW + 8].pixel  = pdc_app_data.colorBoldYellow;
+    tmp[COLOR_BLUE + 8].pixel    = pdc_app_data.colorBoldBlue;
+    tmp[COLOR_MAGENTA + 8].pixel = pdc_app_data.colorBoldMagenta;
+    tmp[COLOR_CYAN + 8].pixel    = pdc_app_data.colorBoldCyan;
+    tmp[COLOR_WHITE + 8].pixel   = pdc_app_data.colorBoldWhite;
+
+    XQueryColors(XCURSESDISPLAY, DefaultColormap(XCURSESDISPLAY,
+                 DefaultScreen(XCURSESDISPLAY)), tmp, 16);
+
+    for (i = 0; i < 16; i++)
+        PDC_set_palette_entry(i, PACK_RGB(tmp[i].red >> 8,
+                              tmp[i].green >> 8, tmp[i].blue >> 8));
 }
 
 static void _get_icon(void)
@@ -339,37 +487,121 @@ static void _get_icon(void)
     }
 }
 
-/* Redraw the entire screen */
+/* (Re)create the backing pixmap at the current window size, keeping
+   as much of the old contents as fit */
+
+static void _get_backing(void)
+{
+    Pixmap old = pdc_backing;
+    Cardinal depth;
+    int width = pdc_wwidth > 0 ? pdc_wwidth : 1;
+    int height = pdc_wheight > 0 ? pdc_wheight : 1;
+
+    if (!pdc_copy_gc)
+    {
+        XGCValues values;
+
+        values.foreground = 0;
+        values.graphics_exposures = False;
+
+        pdc_copy_gc = XCreateGC(XCURSESDISPLAY, XCURSESWIN,
+                                GCForeground | GCGraphicsExposures, &values);
+    }
+
+    XtVaGetValues(pdc_drawing, XtNdepth, &depth, NULL);
+
+    pdc_backing = XCreatePixmap(XCURSESDISPLAY, XCURSESWIN, width, height,
+                                depth);
+
+#ifdef USE_XFT
+    if (pdc_xft_font)
+    {
+        Display *display = XCURSESDISPLAY;
+        int screen = DefaultScreen(display);
+
+        if (pdc_xft_draw)
+            XftDrawChange(pdc_xft_draw, pdc_backing);
+        else
+            pdc_xft_draw = XftDrawCreate(display, pdc_backing,
+                DefaultVisual(display, screen),
+                DefaultColormap(display, screen));
+    }
+#endif
+
+    XFillRectangle(XCURSESDISPLAY, pdc_backing, pdc_copy_gc, 0, 0,
+                   width, height);
+
+    if (old)
+    {
+        XCopyArea(XCURSESDISPLAY, old, pdc_backing, pdc_copy_gc, 0, 0,
+                  width, height, 0, 0);
+        XFreePixmap(XCURSESDISPLAY, old);
+    }
+}
+
+#ifdef USE_XFT
+
+/* Open the Xft fonts named by the xftFont resource, if any, and take
+   the cell size from them. The italic and bold variants are only used
+   if they have the same advance width. */
+
+static XftFont *_open_xft_font(const char *style)
+{
+    Display *display = XtDisplay(pdc_toplevel);
+    XftFont *font;
+    char name[MAX_PATH + 16];
+
+    snprintf(name, sizeof(name), "%s%s", pdc_app_data.xftFont, style);
+
+    font = XftFontOpenName(display, DefaultScreen(display), name);
+
+    if (font && pdc_xft_font && font->max_advance_width != pdc_fwidth)
+    {
+        XftFontClose(display, font);
+        font = NULL;
+    }
+
+    return font;
+}
 
-static void _display_screen(void)
+static void _get_xft_fonts(void)
 {
-    int row;
+    if (!pdc_app_data.xftFont || !*pdc_app_data.xftFont)
+        return;
 
-    PDC_LOG(("_display_screen() - called\n"));
+    pdc_xft_font = _open_xft_font("");
 
-    if (!curscr)
+    if (!pdc_xft_font)
         return;
 
-    for (row = 0; row < SP->lines; row++)
-        PDC_transform_line(row, 0, COLS, curscr->_y[row]);
+    pdc_fwidth = pdc_xft_font->max_advance_width;
+    pdc_fascent = pdc_xft_font->ascent;
+    pdc_fdescent = pdc_xft_font->descent;
+    pdc_fheight = pdc_fascent + pdc_fdescent;
 
-    PDC_redraw_cursor();
+    pdc_xft_italic = _open_xft_font(":italic");
+    pdc_xft_bold = _open_xft_font(":bold");
 }
 
+#endif
+
 static void _handle_expose(Widget w, XtPointer client_data, XEvent *event,
                            Boolean *unused)
 {
     PDC_LOG(("_handle_expose() - called\n"));
 
-    /* ignore all Exposes except last */
+    /* Restore the exposed area from the backing pixmap */
+
+    if (pdc_backing && received_map_notify)
+        XCopyArea(XCURSESDISPLAY, pdc_backing, XCURSESWIN, pdc_copy_gc,
+                  event->xexpose.x, event->xexpose.y,
+                  event->xexpose.width, event->xexpose.height,
+                  event->xexpose.x, event->xexpose.y);
 
     if (event->xexpose.count)
         return;
 
     exposed = TRUE;
-
-    if (received_map_notify)
-        _display_screen();
 }
 
 static void _handle_nonmaskable(Widget w, XtPointer client_data, XEvent *event,
@@ -414,6 +646,7 @@ static void _handle_enter_leave(Widget w, XtPointer client_data,
            not current */
 
         PDC_redraw_cursor();
+        PDC_copy_backing();
         break;
 
     default:
@@ -470,8 +703,8 @@ static void _get_gc(GC *gc, XFontStruct *font_info, int fore, int back)
 
     XSetFont(XCURSESDISPLAY, *gc, font_info->fid);
 
-    XSetForeground(XCURSESDISPLAY, *gc, pdc_color[fore]);
-    XSetBackground(XCURSESDISPLAY, *gc, pdc_color[back]);
+    XSetForeground(XCURSESDISPLAY, *gc, PDC_color_pixel(fore));
+    XSetBackground(XCURSESDISPLAY, *gc, PDC_color_pixel(back));
 }
 
 static void _pointer_setup(void)
@@ -544,6 +777,10 @@ int PDC_scr_open(void)
     pdc_fdescent = pdc_app_data.normalFont->max_bounds.descent;
     pdc_fheight = pdc_fascent + pdc_fdescent;
 
+#ifdef USE_XFT
+    _get_xft_fonts();
+#endif
+
     /* Check that the italic font and normal fonts are the same size */
 
     italic_font_valid = pdc_fwidth ==
@@ -650,6 +887,8 @@ int PDC_scr_open(void)
 
     PDC_LOG(("before _get_gc\n"));
 
+    _get_visual();
+
     _get_gc(&pdc_normal_gc, pdc_app_data.normalFont, COLOR_WHITE, COLOR_BLACK);
 
     _get_gc(&pdc_italic_gc, italic_font_valid ? pdc_app_data.italicFont :
@@ -664,6 +903,8 @@ int PDC_scr_open(void)
     XSetLineAttributes(XCURSESDISPLAY, pdc_cursor_gc, 2,
                        LineSolid, CapButt, JoinMiter);
 
+    _get_backing();
+
     /* Set the pointer for the application */
 
     _pointer_setup();
@@ -702,6 +943,8 @@ int PDC_resize_screen(int nlines, int ncols)
     pdc_wheight = resize_window_height;
     pdc_visible_cursor = TRUE;
 
+    _get_backing();
+
     return OK;
 }
 
@@ -730,33 +973,21 @@ bool PDC_can_change_color(void)
 
 int PDC_color_content(int color, int *red, int *green, int *blue)
 {
-    XColor tmp;
-    Colormap cmap = DefaultColormap(XCURSESDISPLAY,
-                                    DefaultScreen(XCURSESDISPLAY));
-
-    tmp.pixel = pdc_color[color];
-    XQueryColor(XCURSESDISPLAY, cmap, &tmp);
+    const PACKED_RGB col = PDC_get_palette_entry(color);
 
-    *red = ((double)(tmp.red) * 1000 / 65535) + 0.5;
-    *green = ((double)(tmp.green) * 1000 / 65535) + 0.5;
-    *blue = ((double)(tmp.blue) * 1000 / 65535) + 0.5;
+    *red = DIVROUND((col & 0xff) * 1000, 255);
+    *green = DIVROUND(((col >> 8) & 0xff) * 1000, 255);
+    *blue = DIVROUND(((col >> 16) & 0xff) * 1000, 255);
 
     return OK;
 }
 
 int PDC_init_color(int color, int red, int green, int blue)
 {
-    XColor tmp;
-
-    tmp.red = ((double)red * 65535 / 1000) + 0.5;
-    tmp.green = ((double)green * 65535 / 1000) + 0.5;
-    tmp.blue = ((double)blue * 65535 / 1000) + 0.5;
-
-    Colormap cmap = DefaultColormap(XCURSESDISPLAY,
-                                    DefaultScreen(XCURSESDISPLAY));
-
-    if (XAllocColor(XCURSESDISPLAY, cmap, &tmp))
-        pdc_color[color] = tmp.pixel;
+    if (PDC_set_palette_entry(color, PACK_RGB(DIVROUND(red * 255, 1000),
+                                              DIVROUND(green * 255, 1000),
+                                              DIVROUND(blue * 255, 1000))) < 0)
+        return ERR;
 
     return OK;
 }
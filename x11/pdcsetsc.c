@@ -67,7 +67,7 @@ int PDC_set_blink(bool blinkon)
         return ERR;
 
     if (SP->color_started)
-        COLORS = PDC_MAXCOL;
+        COLORS = 256 + (256 * 256 * 256);
 
     if (blinkon)
     {
@@ -6,6 +6,9 @@
 # include <poll.h>
 #endif
 
+#include <time.h>
+#include <sys/time.h>
+
 void PDC_beep(void)
 {
     PDC_LOG(("PDC_beep() - called\n"));
@@ -17,7 +20,7 @@ void PDC_napms(int ms)
 {
     PDC_LOG(("PDC_napms() - called: ms=%d\n", ms));
 
-    XSync(XtDisplay(pdc_toplevel), False);
+    PDC_doupdate();
 
 #if defined(HAVE_USLEEP)
 
@@ -33,6 +36,27 @@ void PDC_napms(int ms)
 #endif
 }
 
+/* milliseconds from an arbitrary starting point; only differences
+   matter. The monotonic clock, where available, isn't affected by
+   changes to the system time. */
+
+long PDC_millisecs(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long)((unsigned long)t.tv_sec * 1000UL +
+                  (unsigned long)t.tv_nsec / 1000000UL);
+#else
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return (long)((unsigned long)t.tv_sec * 1000UL +
+                  (unsigned long)t.tv_usec / 1000UL);
+#endif
+}
+
 const char *PDC_sysname(void)
 {
     return "X11";
@@ -20,6 +20,10 @@
 
 #include <Xatom.h>
 
+#ifdef USE_XFT
+# include <X11/Xft/Xft.h>
+#endif
+
 #define XCURSESDISPLAY (XtDisplay(pdc_drawing))
 #define XCURSESWIN     (XtWindow(pdc_drawing))
 
@@ -57,9 +61,12 @@ typedef struct
     int cursorBlinkRate;
     char *textCursor;
     int textBlinkRate;
+    int syncUpdates;
+#ifdef USE_XFT
+    char *xftFont;
+#endif
 } XCursesAppData;
 
-extern Pixel pdc_color[PDC_MAXCOL];
 extern XIC pdc_xic;
 
 extern XCursesAppData pdc_app_data;
@@ -67,6 +74,13 @@ extern XtAppContext pdc_app_context;
 extern Widget pdc_toplevel, pdc_drawing;
 
 extern GC pdc_normal_gc, pdc_cursor_gc, pdc_italic_gc, pdc_bold_gc;
+extern GC pdc_copy_gc;
+extern Pixmap pdc_backing;
+
+#ifdef USE_XFT
+extern XftFont *pdc_xft_font, *pdc_xft_italic, *pdc_xft_bold;
+extern XftDraw *pdc_xft_draw;
+#endif
 extern int pdc_fheight, pdc_fwidth, pdc_fascent, pdc_fdescent;
 extern int pdc_wwidth, pdc_wheight;
 
@@ -77,6 +91,12 @@ int PDC_display_cursor(int, int, int, int, int);
 
 void PDC_blink_cursor(XtPointer, XtIntervalId *);
 void PDC_blink_text(XtPointer, XtIntervalId *);
+Pixel PDC_color_pixel(int);
+void PDC_copy_backing(void);
 int PDC_kb_setup(void);
 void PDC_redraw_cursor(void);
+void PDC_reset_gc_state(void);
+#ifdef USE_XFT
+void PDC_free_xft_colors(void);
+#endif
 bool PDC_scrollbar_init(const char *);